@@ -0,0 +1,247 @@
+// Spooky Scoreboard Daemon
+// Copyright (C) 2025 Greg MacKenzie
+// https://spookyscoreboard.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// Benchmarks every game's score and audit parsers against the fixtures
+// in bench/fixtures/<game>, which mirror each cabinet's file system.
+//
+// Each parser also runs against copies whose audits were inflated with
+// extra entries, to show how parsing scales with audit file size.
+
+#include <atomic>
+#include <fstream>
+#include <map>
+#include <new>
+#include <cstdio>
+#include <cstdlib>
+
+#include <unistd.h>
+#include <ftw.h>
+#include <sys/stat.h>
+#include <benchmark/benchmark.h>
+#include <json/json.h>
+
+#include "GameBase.h"
+
+#ifndef SSBD_BENCH_FIXTURES
+#define SSBD_BENCH_FIXTURES "bench/fixtures"
+#endif
+
+using namespace std;
+
+// Counts every allocation made through operator new.
+static atomic<uint64_t> allocCount{0};
+static atomic<uint64_t> allocBytes{0};
+
+void* operator new(size_t n)
+{
+  allocCount.fetch_add(1, memory_order_relaxed);
+  allocBytes.fetch_add(n, memory_order_relaxed);
+  if (void* p = malloc(n ? n : 1)) return p;
+  throw bad_alloc();
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+namespace
+{
+  enum class Op { HighScores, LastScores, GamesPlayed };
+
+  const string& fileFor(const GameBase& game, Op op)
+  {
+    switch (op) {
+    case Op::HighScores: return game.getHighScoresFile();
+    case Op::LastScores: return game.getLastScoresFile();
+    default: return game.getAuditsFile();
+    }
+  }
+
+  const int inflateSizes[] = {0, 100, 1000, 10000};
+
+  // Inflated fixture trees, by game and audit count; removed at exit.
+  map<pair<string, int>, string> trees;
+
+  void mkdirs(const string& path)
+  {
+    for (size_t pos = path.find('/', 1); ; pos = path.find('/', pos + 1)) {
+      mkdir(path.substr(0, pos).c_str(), 0755);
+      if (pos == string::npos) break;
+    }
+  }
+
+  void copyFile(const string& from, const string& to)
+  {
+    ifstream in(from, ios::binary);
+    ofstream out(to, ios::binary);
+    if (!in || !out) throw runtime_error("Failed to copy fixture " + from);
+    out << in.rdbuf();
+  }
+
+  /**
+   * Appends n audit entries. JSON audits gain top-level members; YAML
+   * audits gain keys in the "Audits" map, which is last in each fixture.
+   */
+  void inflateAudits(const string& path, int n)
+  {
+    if (path.size() > 5 && path.compare(path.size() - 5, 5, ".json") == 0) {
+      Json::Value root;
+      ifstream in(path);
+      if (!Json::Reader().parse(in, root)) throw runtime_error("Invalid fixture " + path);
+      in.close();
+
+      for (int i = 0; i < n; i++) {
+        char key[32];
+        snprintf(key, sizeof(key), "audit_%05d", i);
+        root[key]["label"] = string("Audit ") + to_string(i);
+        root[key]["value"] = i;
+      }
+
+      ofstream(path) << root;
+      return;
+    }
+
+    ofstream out(path, ios::app);
+    for (int i = 0; i < n; i++) {
+      out << "  Audit " << i << ": " << i << "\n";
+    }
+  }
+
+  /**
+   * Returns the root to relocate a game to, creating an inflated copy
+   * of its fixtures on first use.
+   */
+  const string& fixtureRoot(const string& key, GameBase& game, int inflate)
+  {
+    auto it = trees.find({key, inflate});
+    if (it != trees.end()) return it->second;
+
+    string src = string(SSBD_BENCH_FIXTURES) + "/" + key;
+    if (inflate == 0) return trees[{key, inflate}] = src;
+
+    char tmpl[] = "/tmp/ssbd-bench-XXXXXX";
+    if (!mkdtemp(tmpl)) throw runtime_error("Failed to create temporary directory");
+
+    string root(tmpl);
+    mkdirs(root + game.getScoresPath());
+
+    for (const string& file : {game.getHighScoresFile(), game.getLastScoresFile(), game.getAuditsFile()}) {
+      string rel = game.getScoresPath() + "/" + file;
+      copyFile(src + rel, root + rel);
+    }
+
+    inflateAudits(root + game.getScoresPath() + "/" + game.getAuditsFile(), inflate);
+    return trees[{key, inflate}] = root;
+  }
+
+  void removeTrees()
+  {
+    for (const auto& tree : trees) {
+      if (tree.first.second == 0) continue;
+      nftw(tree.second.c_str(), [](const char* path, const struct stat*, int, struct FTW*) {
+        return remove(path);
+      }, 16, FTW_DEPTH | FTW_PHYS);
+    }
+  }
+
+  void runParser(benchmark::State& state, const string& key, Op op)
+  {
+    unique_ptr<GameBase> game = GameBase::create(key);
+    int inflate = static_cast<int>(state.range(0));
+
+    try {
+      game->relocate(fixtureRoot(key, *game, inflate));
+    }
+    catch (const runtime_error& e) {
+      state.SkipWithError(e.what());
+      return;
+    }
+
+    uint64_t count = allocCount.load(memory_order_relaxed);
+    uint64_t bytes = allocBytes.load(memory_order_relaxed);
+
+    for (auto _ : state) {
+      try {
+        switch (op) {
+        case Op::HighScores:
+          benchmark::DoNotOptimize(game->processHighScores());
+          break;
+        case Op::LastScores:
+          benchmark::DoNotOptimize(game->processLastGameScores());
+          break;
+        case Op::GamesPlayed:
+          benchmark::DoNotOptimize(game->getGamesPlayed());
+          break;
+        }
+      }
+      catch (const exception& e) {
+        state.SkipWithError(e.what());
+        break;
+      }
+    }
+
+    state.counters["allocs"] = benchmark::Counter(
+      static_cast<double>(allocCount.load(memory_order_relaxed) - count),
+      benchmark::Counter::kAvgIterations);
+
+    state.counters["alloc_bytes"] = benchmark::Counter(
+      static_cast<double>(allocBytes.load(memory_order_relaxed) - bytes),
+      benchmark::Counter::kAvgIterations);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  const pair<const char*, Op> ops[] = {
+    {"processHighScores", Op::HighScores},
+    {"processLastGameScores", Op::LastScores},
+    {"getGamesPlayed", Op::GamesPlayed},
+  };
+
+  for (const auto& factory : gameFactories) {
+    unique_ptr<GameBase> game = factory.second();
+
+    for (const auto& op : ops) {
+      string name = factory.first + "/" + op.first;
+      string key = factory.first;
+      Op which = op.second;
+
+      auto* b = benchmark::RegisterBenchmark(name.c_str(), [key, which](benchmark::State& state) {
+        runParser(state, key, which);
+      });
+
+      // Inflating audits only matters to parsers that read the audits file.
+      b->ArgName("audits");
+      if (fileFor(*game, which) == game->getAuditsFile()) {
+        for (int n : inflateSizes) b->Arg(n);
+      }
+      else {
+        b->Arg(0);
+      }
+    }
+  }
+
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+
+  removeTrees();
+  return 0;
+}
+
+// vim: set ts=2 sw=2 expandtab:
@@ -0,0 +1,247 @@
+// Spooky Scoreboard Daemon
+// Copyright (C) 2025 Greg MacKenzie
+// https://spookyscoreboard.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <fstream>
+
+#include "Machine.h"
+#include "AuditCollector.h"
+#include "WebSocket.h"
+#include "Log.h"
+
+using namespace std;
+
+namespace
+{
+  Metrics::Counter& uploads = Metrics::counter(
+    "ssbd_audit_uploads_total", "Audit uploads sent.");
+  Metrics::Counter& counters = Metrics::counter(
+    "ssbd_audit_counters_total", "Audit counters sent, summed over uploads.");
+}
+
+Json::Value AuditCollector::diff(const GameBase::Audits& from, const GameBase::Audits& to)
+{
+  Json::Value delta(Json::objectValue);
+  auto a = from.begin();
+
+  for (const auto& counter : to) {
+    while (a != from.end() && a->first < counter.first) ++a;
+
+    int64_t before = (a != from.end() && a->first == counter.first) ? a->second : 0;
+    if (counter.second < before) return Json::nullValue;
+    if (counter.second != before) delta[counter.first] = static_cast<Json::Int64>(counter.second - before);
+  }
+
+  return delta;
+}
+
+AuditCollector::AuditCollector(Machine& m) : machine(m), due(Clock::now())
+{
+  load();
+}
+
+AuditCollector::~AuditCollector()
+{
+  stop();
+}
+
+void AuditCollector::start()
+{
+  lock_guard<mutex> lock(mtx);
+  if (running) return;
+
+  running = true;
+  worker = thread(&AuditCollector::run, this);
+}
+
+void AuditCollector::stop()
+{
+  {
+    lock_guard<mutex> lock(mtx);
+    if (!running) return;
+    running = false;
+  }
+
+  cv.notify_all();
+  if (worker.joinable()) worker.join();
+}
+
+void AuditCollector::run()
+{
+  unique_lock<mutex> lock(mtx);
+
+  while (running) {
+    if (cv.wait_until(lock, due, [this]() { return !running || Clock::now() >= due; })) {
+      if (!running) break;
+
+      lock.unlock();
+      tick();
+      lock.lock();
+    }
+  }
+}
+
+void AuditCollector::notify()
+{
+  lock_guard<mutex> lock(mtx);
+
+  interval = chrono::seconds(AUDIT_INTERVAL_MIN);
+  due = min(due, Clock::now() + interval);
+  cv.notify_all();
+}
+
+void AuditCollector::tick()
+{
+  const auto now = Clock::now();
+
+  {
+    lock_guard<mutex> lock(mtx);
+    if (now < due) return;
+
+    // One upload at a time; the next delta depends on this one's ack.
+    if (inFlight && now - sentAt < chrono::seconds(AUDIT_ACK_TIMEOUT)) {
+      due = sentAt + chrono::seconds(AUDIT_ACK_TIMEOUT);
+      return;
+    }
+
+    inFlight = false;
+  }
+
+  GameBase::Audits current;
+  try {
+    current = machine.game->processAudits();
+  }
+  catch (const runtime_error& e) {
+    LOG_ERROR << "Exception: " << e.what();
+  }
+
+  lock_guard<mutex> lock(mtx);
+
+  if (!current.empty() && current != acked) {
+    upload(current);
+    interval = chrono::seconds(AUDIT_INTERVAL_MIN);
+  }
+  else {
+    interval = min(interval * 2, chrono::seconds(AUDIT_INTERVAL_MAX));
+  }
+
+  due = now + interval;
+}
+
+/**
+ * Sends the counters that changed since the last acknowledged upload.
+ * Called with the lock held.
+ */
+void AuditCollector::upload(const GameBase::Audits& current)
+{
+  Json::Value delta = seq == 0 ? Json::Value(Json::nullValue) : diff(acked, current);
+
+  Json::Value body;
+  body["base"] = static_cast<Json::UInt64>(seq);
+  body["seq"] = static_cast<Json::UInt64>(seq + 1);
+
+  if (delta.isNull()) {
+    for (const auto& counter : current) {
+      body["full"][counter.first] = static_cast<Json::Int64>(counter.second);
+    }
+    counters.inc(current.size());
+  }
+  else {
+    body["delta"] = delta;
+    counters.inc(delta.size());
+  }
+
+  inFlight = true;
+  sentAt = Clock::now();
+  uploads.inc();
+
+  const uint64_t sentSeq = seq + 1;
+  machine.webSocket->send({"/api/v1/audits", "POST", &body}, [this, current, sentSeq](const WebSocket::Response& response) {
+    onResponse(response, current, sentSeq);
+  });
+}
+
+void AuditCollector::onResponse(const WebSocket::Response& response, const GameBase::Audits& sent, uint64_t sentSeq)
+{
+  lock_guard<mutex> lock(mtx);
+  inFlight = false;
+
+  switch (response.status) {
+  case 200:
+    acked = sent;
+    seq = sentSeq;
+    save();
+    break;
+
+  case 409:
+    // The server holds a different base; start over with everything.
+    LOG_WARNING << "Audit sequence mismatch, sending full audits.";
+    acked.clear();
+    seq = 0;
+    due = Clock::now();
+    cv.notify_all();
+    break;
+
+  default:
+    LOG_ERROR << "Failed to upload audits.";
+    break;
+  }
+}
+
+/**
+ * Restores the last acknowledged snapshot, so a restart doesn't
+ * resend every counter.
+ */
+void AuditCollector::load()
+{
+  ifstream file(getPath());
+  if (!file.is_open()) return;
+
+  Json::Value root;
+  if (!Json::Reader().parse(file, root) || !root["counters"].isObject()) return;
+
+  for (const auto& name : root["counters"].getMemberNames()) {
+    acked.emplace_back(name, root["counters"][name].asInt64());
+  }
+  seq = root["seq"].asUInt64();
+}
+
+void AuditCollector::save() const
+{
+  Json::Value root;
+  root["seq"] = static_cast<Json::UInt64>(seq);
+  for (const auto& counter : acked) {
+    root["counters"][counter.first] = static_cast<Json::Int64>(counter.second);
+  }
+
+  Json::StreamWriterBuilder builder;
+  builder["indentation"] = "";
+
+  ofstream file(getPath());
+  if (!file.is_open()) {
+    LOG_ERROR << "Failed to write " << getPath();
+    return;
+  }
+
+  file << Json::writeString(builder, root);
+}
+
+const string AuditCollector::getPath() const
+{
+  return machine.game->getGamePath() + "/.ssbd-audits.json";
+}
+
+// vim: set ts=2 sw=2 expandtab:
@@ -0,0 +1,105 @@
+// Spooky Scoreboard Daemon
+// Copyright (C) 2025 Greg MacKenzie
+// https://spookyscoreboard.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include <json/json.h>
+
+#include "GameBase.h"
+
+// Checks back off from AUDIT_INTERVAL_MIN to AUDIT_INTERVAL_MAX while
+// nothing changes. Seconds.
+#define AUDIT_INTERVAL_MIN 300
+#define AUDIT_INTERVAL_MAX 21600
+
+// Send again if an upload isn't acknowledged within this many seconds.
+#define AUDIT_ACK_TIMEOUT 120
+
+struct Machine;
+
+/**
+ * Uploads the game's audit counters, sending only those that changed.
+ *
+ * Each upload is a delta against the snapshot the server last
+ * acknowledged, numbered so a repeated or lost upload can't be counted
+ * twice: {"base": N, "seq": N + 1, "delta": {...}}. The first upload,
+ * or any after the counters were reset, carries "full" instead.
+ */
+class AuditCollector
+{
+public:
+  explicit AuditCollector(Machine& m);
+  ~AuditCollector();
+
+  AuditCollector(const AuditCollector&) = delete;
+  AuditCollector& operator=(const AuditCollector&) = delete;
+
+  /**
+   * @brief Runs tick() on a thread of its own until stopped.
+   */
+  void start();
+  void stop();
+
+  /**
+   * @brief Checks the audits if due, uploading any changes.
+   */
+  void tick();
+
+  /**
+   * @brief Brings the next check forward; call when a game ends.
+   */
+  void notify();
+
+  /**
+   * @brief Changed counters as increments, or null if any went down,
+   *        meaning the audits were reset. Both must be sorted by name.
+   */
+  static Json::Value diff(const GameBase::Audits& from, const GameBase::Audits& to);
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  Machine& machine;
+
+  // Counters as last acknowledged by the server, and their number.
+  GameBase::Audits acked;
+  uint64_t seq = 0;
+
+  bool inFlight = false;
+  Clock::time_point sentAt;
+  Clock::time_point due;
+  std::chrono::seconds interval{AUDIT_INTERVAL_MIN};
+
+  bool running = false;
+  std::mutex mtx;
+  std::condition_variable cv;
+  std::thread worker;
+
+  void run();
+  void upload(const GameBase::Audits& current);
+  void onResponse(const WebSocket::Response& response, const GameBase::Audits& sent, uint64_t sentSeq);
+  void load();
+  void save() const;
+  const std::string getPath() const;
+};
+
+// vim: set ts=2 sw=2 expandtab:
@@ -0,0 +1,333 @@
+// Spooky Scoreboard Daemon
+// Copyright (C) 2025 Greg MacKenzie
+// https://spookyscoreboard.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <cmath>
+#include <cstring>
+
+#include "Cbor.h"
+
+using namespace std;
+
+namespace
+{
+  enum Major : uint8_t {
+    Unsigned = 0,
+    Negative = 1,
+    Bytes = 2,
+    Text = 3,
+    Array = 4,
+    Map = 5,
+    Tag = 6,
+    Simple = 7
+  };
+
+  // Additional info value for indefinite lengths, and the "break" byte.
+  const uint8_t indefinite = 31;
+  const uint8_t breakByte = 0xff;
+
+  void writeHead(string& out, Major major, uint64_t n)
+  {
+    const uint8_t m = static_cast<uint8_t>(major << 5);
+    int bytes;
+
+    if (n < 24) {
+      out += static_cast<char>(m | n);
+      return;
+    }
+    else if (n <= 0xff) {
+      out += static_cast<char>(m | 24);
+      bytes = 1;
+    }
+    else if (n <= 0xffff) {
+      out += static_cast<char>(m | 25);
+      bytes = 2;
+    }
+    else if (n <= 0xffffffff) {
+      out += static_cast<char>(m | 26);
+      bytes = 4;
+    }
+    else {
+      out += static_cast<char>(m | 27);
+      bytes = 8;
+    }
+
+    for (int i = bytes - 1; i >= 0; i--) {
+      out += static_cast<char>((n >> (i * 8)) & 0xff);
+    }
+  }
+
+  void writeString(string& out, const char* begin, const char* end)
+  {
+    writeHead(out, Text, static_cast<uint64_t>(end - begin));
+    out.append(begin, end);
+  }
+
+  class Decoder
+  {
+  public:
+    explicit Decoder(const string& in) : p(in.data()), end(in.data() + in.size()) {}
+
+    bool item(Json::Value& out, int depth);
+    bool done() const { return p == end; }
+
+  private:
+    const char* p;
+    const char* end;
+
+    bool head(uint8_t& major, uint8_t& info, uint64_t& n);
+    bool text(uint8_t major, uint8_t info, uint64_t n, std::string& out);
+    bool uint(int bytes, uint64_t& n);
+  };
+
+  bool Decoder::uint(int bytes, uint64_t& n)
+  {
+    if (end - p < bytes) return false;
+
+    n = 0;
+    for (int i = 0; i < bytes; i++) {
+      n = (n << 8) | static_cast<uint8_t>(*p++);
+    }
+
+    return true;
+  }
+
+  bool Decoder::head(uint8_t& major, uint8_t& info, uint64_t& n)
+  {
+    if (p == end) return false;
+
+    const uint8_t b = static_cast<uint8_t>(*p++);
+    major = b >> 5;
+    info = b & 0x1f;
+
+    if (info < 24) {
+      n = info;
+      return true;
+    }
+
+    switch (info) {
+    case 24: return uint(1, n);
+    case 25: return uint(2, n);
+    case 26: return uint(4, n);
+    case 27: return uint(8, n);
+    case indefinite:
+      n = 0;
+      return major == Bytes || major == Text || major == Array || major == Map || major == Simple;
+    default:
+      return false;
+    }
+  }
+
+  bool Decoder::text(uint8_t major, uint8_t info, uint64_t n, std::string& out)
+  {
+    if (info != indefinite) {
+      if (static_cast<uint64_t>(end - p) < n) return false;
+      out.append(p, static_cast<size_t>(n));
+      p += n;
+      return true;
+    }
+
+    // Indefinite length: definite chunks of the same type until a break.
+    while (p != end && static_cast<uint8_t>(*p) != breakByte) {
+      uint8_t m, i;
+      uint64_t len;
+      if (!head(m, i, len) || m != major || i == indefinite) return false;
+      if (!text(m, i, len, out)) return false;
+    }
+
+    if (p == end) return false;
+    ++p;
+    return true;
+  }
+
+  bool Decoder::item(Json::Value& out, int depth)
+  {
+    if (depth > CBOR_MAX_DEPTH) return false;
+
+    uint8_t major, info;
+    uint64_t n;
+    if (!head(major, info, n)) return false;
+
+    switch (major) {
+    case Unsigned:
+      // Match Json::Reader, which only uses unsigned values when it has to.
+      if (n <= static_cast<uint64_t>(INT64_MAX)) out = static_cast<Json::Int64>(n);
+      else out = static_cast<Json::UInt64>(n);
+      return true;
+
+    case Negative:
+      if (n > static_cast<uint64_t>(INT64_MAX)) return false;
+      out = static_cast<Json::Int64>(-1 - static_cast<int64_t>(n));
+      return true;
+
+    case Bytes:
+    case Text: {
+      std::string s;
+      if (!text(major, info, n, s)) return false;
+      out = s;
+      return true;
+    }
+
+    case Array:
+      out = Json::Value(Json::arrayValue);
+      for (uint64_t i = 0; info == indefinite || i < n; i++) {
+        if (info == indefinite && p != end && static_cast<uint8_t>(*p) == breakByte) {
+          ++p;
+          break;
+        }
+        if (!item(out.append(Json::Value()), depth + 1)) return false;
+      }
+      return true;
+
+    case Map:
+      out = Json::Value(Json::objectValue);
+      for (uint64_t i = 0; info == indefinite || i < n; i++) {
+        if (info == indefinite && p != end && static_cast<uint8_t>(*p) == breakByte) {
+          ++p;
+          break;
+        }
+
+        Json::Value key;
+        if (!item(key, depth + 1)) return false;
+        if (!key.isString() && !key.isIntegral()) return false;
+        if (!item(out[key.asString()], depth + 1)) return false;
+      }
+      return true;
+
+    case Tag:
+      return item(out, depth + 1);
+
+    default:
+      break;
+    }
+
+    // Major type 7: simple values and floats.
+    switch (info) {
+    case 20:
+      out = false;
+      return true;
+    case 21:
+      out = true;
+      return true;
+    case 22:
+    case 23:
+      out = Json::Value();
+      return true;
+    case 25: {
+      // Half precision.
+      const int e = static_cast<int>((n >> 10) & 0x1f);
+      const double mant = static_cast<double>(n & 0x3ff);
+      double v;
+      if (e == 0) v = ldexp(mant, -24);
+      else if (e != 31) v = ldexp(mant + 1024, e - 25);
+      else v = mant == 0 ? INFINITY : NAN;
+      out = (n & 0x8000) ? -v : v;
+      return true;
+    }
+    case 26: {
+      float f;
+      const uint32_t bits = static_cast<uint32_t>(n);
+      memcpy(&f, &bits, sizeof(f));
+      out = static_cast<double>(f);
+      return true;
+    }
+    case 27: {
+      double d;
+      memcpy(&d, &n, sizeof(d));
+      out = d;
+      return true;
+    }
+    default:
+      return false;
+    }
+  }
+}
+
+void Cbor::encode(const Json::Value& value, string& out)
+{
+  switch (value.type()) {
+  case Json::nullValue:
+    out += static_cast<char>(0xf6);
+    break;
+
+  case Json::booleanValue:
+    out += static_cast<char>(value.asBool() ? 0xf5 : 0xf4);
+    break;
+
+  case Json::intValue: {
+    const int64_t v = value.asInt64();
+    if (v >= 0) writeHead(out, Unsigned, static_cast<uint64_t>(v));
+    else writeHead(out, Negative, static_cast<uint64_t>(-1 - v));
+    break;
+  }
+
+  case Json::uintValue:
+    writeHead(out, Unsigned, value.asUInt64());
+    break;
+
+  case Json::realValue: {
+    const double d = value.asDouble();
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof(bits));
+    out += static_cast<char>(0xfb);
+    for (int i = 7; i >= 0; i--) {
+      out += static_cast<char>((bits >> (i * 8)) & 0xff);
+    }
+    break;
+  }
+
+  case Json::stringValue: {
+    const char* begin;
+    const char* end;
+    value.getString(&begin, &end);
+    writeString(out, begin, end);
+    break;
+  }
+
+  case Json::arrayValue:
+    writeHead(out, Array, value.size());
+    for (const auto& v : value) encode(v, out);
+    break;
+
+  case Json::objectValue:
+    writeHead(out, Map, value.size());
+    for (auto it = value.begin(); it != value.end(); ++it) {
+      const char* end;
+      const char* begin = it.memberName(&end);
+      writeString(out, begin, end);
+      encode(*it, out);
+    }
+    break;
+  }
+}
+
+void Cbor::encodeMap(size_t n, string& out)
+{
+  writeHead(out, Map, n);
+}
+
+void Cbor::encodeString(const char* s, size_t len, string& out)
+{
+  writeString(out, s, s + len);
+}
+
+bool Cbor::decode(const string& in, Json::Value& out)
+{
+  Decoder decoder(in);
+  return decoder.item(out, 0) && decoder.done();
+}
+
+// vim: set ts=2 sw=2 expandtab:
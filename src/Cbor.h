@@ -0,0 +1,58 @@
+// Spooky Scoreboard Daemon
+// Copyright (C) 2025 Greg MacKenzie
+// https://spookyscoreboard.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <string>
+
+#include <json/json.h>
+
+// Deepest nesting accepted when decoding.
+#define CBOR_MAX_DEPTH 32
+
+/**
+ * CBOR (RFC 8949) encoding of JSON values, for the binary wire format.
+ *
+ * Only the JSON data model is covered: byte strings decode as text and
+ * tags are skipped.
+ */
+namespace Cbor
+{
+  /**
+   * @brief Appends the encoding of a value to out.
+   *
+   * Callers can reuse one buffer across messages to avoid allocating.
+   */
+  void encode(const Json::Value& value, std::string& out);
+
+  /**
+   * @brief Appends the head of a map with n entries, which the caller
+   *        follows with n key/value pairs.
+   */
+  void encodeMap(size_t n, std::string& out);
+
+  void encodeString(const char* s, size_t len, std::string& out);
+
+  /**
+   * @brief Decodes a single item.
+   *
+   * @return False if the input is malformed or has trailing bytes.
+   */
+  bool decode(const std::string& in, Json::Value& out);
+}
+
+// vim: set ts=2 sw=2 expandtab:
@@ -15,34 +15,33 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
-#include <iostream>
+#include <cstdio>
 #include <fstream>
+#include <stdexcept>
 
+#include <fcntl.h>
+#include <unistd.h>
 #include <uuid/uuid.h>
 
-#include "main.h"
 #include "Config.h"
+#include "GameBase.h"
+#include "Log.h"
 
 using namespace std;
 
-string Config::machineId;
-string Config::token;
-
 void Config::load()
 {
-  string path = game->getGamePath() + "/" + configFile;
+  string path = getDefaultPath();
 
   ifstream file(path);
   if (!file.is_open()) {
-    cerr << "Failed to open " << path << endl;
-    exit(EXIT_FAILURE);
+    throw runtime_error("Failed to open " + path);
   }
 
   Json::Value root;
   Json::Reader reader;
   if (!reader.parse(file, root)) {
-    cerr << "Failed to parse " << path << endl;
-    exit(EXIT_FAILURE);
+    throw runtime_error("Failed to parse " + path);
   }
 
   file.close();
@@ -50,38 +49,67 @@ void Config::load()
   machineId = root["uuid"].asString();
   token = root["token"].asString();
 
+  gatewayUrl = root["gateway_url"].asString();
+  gatewaySecret = root["gateway_secret"].asString();
+  relaySecret = root["relay"]["secret"].asString();
+  relayCert = root["relay"]["cert"].asString();
+  relayKey = root["relay"]["key"].asString();
+
+  endpoints.clear();
+  for (const auto& url : root["endpoints"]) {
+    if (url.isString()) endpoints.push_back(url.asString());
+  }
+
   uuid_t uuid;
   if (machineId.empty() || uuid_parse(machineId.c_str(), uuid) != 0) {
-    cerr << "Invalid machine UUID." << endl;
-    exit(EXIT_FAILURE);
+    throw runtime_error("Invalid machine UUID.");
   }
 }
 
 void Config::save(const Json::Value& config, const string& path)
 {
-  ofstream file(path);
-  if (!file.is_open()) {
-    cerr << "Failed to write " << path << endl;
-    cout << "Config:\n" << config << endl;
-    exit(EXIT_FAILURE);
-  }
-
   Json::StreamWriterBuilder builder;
   builder["indentation"] = "";
-  file << Json::writeString(builder, config);
-  file.close();
 
-  cout << "Configuration saved." << endl;
+  const string data = Json::writeString(builder, config);
+
+  // Written aside and renamed over, so a crash leaves the old file.
+  const string tmp = path + ".tmp";
+  int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  bool ok = fd >= 0;
+
+  ok = ok && write(fd, data.data(), data.size()) == static_cast<ssize_t>(data.size());
+  ok = ok && fsync(fd) == 0;
+  if (fd >= 0) close(fd);
+
+  if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+    LOG_INFO << "Config: " << data;
+    unlink(tmp.c_str());
+    throw runtime_error("Failed to write " + path);
+  }
+
+  LOG_INFO << "Configuration saved.";
 }
 
-void Config::save(const Json::Value& config)
+void Config::save(const Json::Value& config) const
 {
-  save(config, getDefaultPath());
+  const string path = getDefaultPath();
+
+  Json::Value root;
+  ifstream file(path);
+  if (file.is_open()) Json::Reader().parse(file, root);
+  if (!root.isObject()) root = Json::Value(Json::objectValue);
+
+  for (const auto& key : config.getMemberNames()) {
+    root[key] = config[key];
+  }
+
+  save(root, path);
 }
 
-const string Config::getDefaultPath()
+const string Config::getDefaultPath() const
 {
-  return game->getGamePath() + "/" + configFile;
+  return game.getGamePath() + "/" + configFile;
 }
 
 // vim: set ts=2 sw=2 expandtab:
@@ -18,21 +18,55 @@
 #pragma once
 
 #include <string>
+#include <vector>
+
 #include <json/json.h>
 
+class GameBase;
+
+/**
+ * A machine's identity and credentials, kept in the game directory.
+ */
 class Config
 {
 public:
-  static void load();
+  explicit Config(const GameBase& g) : game(g) {}
+
+  /**
+   * @brief Reads the file. Throws runtime_error if it's missing or
+   *        invalid.
+   */
+  void load();
+
+  /**
+   * @brief Saves fields over those already in the file. Throws
+   *        runtime_error if it can't be written.
+   */
+  void save(const Json::Value& config) const;
   static void save(const Json::Value& config, const std::string& path);
-  static void save(const Json::Value& config);
-  static const std::string getDefaultPath();
+  const std::string getDefaultPath() const;
 
-  static std::string machineId;
-  static std::string token;
+  std::string machineId;
+  std::string token;
+
+  // Backend URLs to choose between; empty for the default.
+  std::vector<std::string> endpoints;
+
+  // The gateway this machine connects through, and the secret it's
+  // presented with; never sent to any other endpoint.
+  std::string gatewayUrl;
+  std::string gatewaySecret;
+
+  // Serving as a gateway (-G): the secret cabinets must present, and a
+  // certificate and key to serve wss:// with.
+  std::string relaySecret;
+  std::string relayCert;
+  std::string relayKey;
 
 private:
   static constexpr const char* configFile = ".ssbd.json";
+
+  const GameBase& game;
 };
 
 // vim: set ts=2 sw=2 expandtab:
@@ -0,0 +1,254 @@
+// Spooky Scoreboard Daemon
+// Copyright (C) 2025 Greg MacKenzie
+// https://spookyscoreboard.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "Endpoints.h"
+#include "Log.h"
+#include "Metrics.h"
+
+using namespace std;
+
+void Endpoints::set(const vector<string>& urls)
+{
+  lock_guard<mutex> lock(mtx);
+  vector<Endpoint> next;
+
+  for (const auto& url : urls) {
+    if (any_of(next.begin(), next.end(), [&](const Endpoint& e) { return e.url == url; })) continue;
+
+    Endpoint* e = find(url);
+    next.push_back(e ? *e : Endpoint());
+    next.back().url = url;
+  }
+
+  endpoints = move(next);
+}
+
+void Endpoints::probe()
+{
+  struct Probe {
+    string url;
+    int fd = -1;
+    Clock::time_point start;
+    double rtt = -1;
+  };
+
+  vector<Probe> probes;
+  {
+    lock_guard<mutex> lock(mtx);
+    for (const auto& e : endpoints) {
+      probes.emplace_back();
+      probes.back().url = e.url;
+    }
+  }
+
+  vector<pollfd> fds;
+
+  for (auto& p : probes) {
+    string host, port;
+    if (!parseUrl(p.url, host, port)) {
+      LOG_ERROR << "Invalid endpoint: " << p.url;
+      continue;
+    }
+
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    addrinfo* res = nullptr;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &res) != 0 || !res) continue;
+
+    p.fd = ::socket(res->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (p.fd >= 0) {
+      p.start = Clock::now();
+      if (::connect(p.fd, res->ai_addr, res->ai_addrlen) == 0) {
+        p.rtt = chrono::duration<double>(Clock::now() - p.start).count();
+      }
+      else if (errno == EINPROGRESS) {
+        fds.push_back({p.fd, POLLOUT, 0});
+      }
+    }
+
+    freeaddrinfo(res);
+  }
+
+  const auto deadline = Clock::now() + chrono::milliseconds(ENDPOINT_PROBE_TIMEOUT_MS);
+  size_t waiting = fds.size();
+
+  while (waiting > 0) {
+    auto left = chrono::duration_cast<chrono::milliseconds>(deadline - Clock::now()).count();
+    if (left <= 0 || poll(fds.data(), fds.size(), static_cast<int>(left)) <= 0) break;
+
+    const auto now = Clock::now();
+    for (auto& f : fds) {
+      if (f.fd < 0 || f.revents == 0) continue;
+
+      int err = 0;
+      socklen_t len = sizeof(err);
+      getsockopt(f.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+
+      for (auto& p : probes) {
+        if (p.fd == f.fd && err == 0) p.rtt = chrono::duration<double>(now - p.start).count();
+      }
+
+      // Negative descriptors are ignored by poll.
+      f.fd = -1;
+      --waiting;
+    }
+  }
+
+  lock_guard<mutex> lock(mtx);
+
+  for (auto& p : probes) {
+    if (p.fd >= 0) close(p.fd);
+
+    Endpoint* e = find(p.url);
+    if (!e) continue;
+
+    if (p.rtt < 0) {
+      LOG_DEBUG << "Endpoint unreachable: " << p.url;
+      fail(*e);
+      continue;
+    }
+
+    e->rtt = e->rtt < 0 ? p.rtt : 0.7 * e->rtt + 0.3 * p.rtt;
+    Metrics::histogram("ssbd_ws_probe_seconds", "TCP connection time to each endpoint.",
+                       {{"endpoint", p.url}}).observe(static_cast<uint64_t>(p.rtt * 1e9));
+  }
+}
+
+vector<string> Endpoints::ranked()
+{
+  lock_guard<mutex> lock(mtx);
+  vector<const Endpoint*> order;
+  for (const auto& e : endpoints) order.push_back(&e);
+
+  stable_sort(order.begin(), order.end(), [this](const Endpoint* a, const Endpoint* b) {
+    bool ha = isHealthy(*a), hb = isHealthy(*b);
+    if (ha != hb) return ha;
+    if (!ha) return a->downUntil < b->downUntil;
+    if (a->rtt < 0 || b->rtt < 0) return a->rtt >= 0 && b->rtt < 0;
+    return a->rtt < b->rtt;
+  });
+
+  vector<string> urls;
+  for (const Endpoint* e : order) urls.push_back(e->url);
+  return urls;
+}
+
+void Endpoints::failed(const string& url)
+{
+  lock_guard<mutex> lock(mtx);
+  if (Endpoint* e = find(url)) fail(*e);
+}
+
+void Endpoints::succeeded(const string& url)
+{
+  lock_guard<mutex> lock(mtx);
+  if (Endpoint* e = find(url)) e->failures = 0;
+}
+
+bool Endpoints::healthy(const string& url)
+{
+  lock_guard<mutex> lock(mtx);
+  Endpoint* e = find(url);
+  return e && isHealthy(*e);
+}
+
+double Endpoints::rtt(const string& url)
+{
+  lock_guard<mutex> lock(mtx);
+  Endpoint* e = find(url);
+  return e ? e->rtt : -1;
+}
+
+size_t Endpoints::size()
+{
+  lock_guard<mutex> lock(mtx);
+  return endpoints.size();
+}
+
+Endpoints::Endpoint* Endpoints::find(const string& url)
+{
+  for (auto& e : endpoints) {
+    if (e.url == url) return &e;
+  }
+  return nullptr;
+}
+
+void Endpoints::fail(Endpoint& e)
+{
+  if (++e.failures < ENDPOINT_FAILURES) return;
+
+  const int shift = min(e.failures - ENDPOINT_FAILURES, 10);
+  const int secs = min(ENDPOINT_COOLDOWN << shift, ENDPOINT_COOLDOWN_MAX);
+  e.downUntil = Clock::now() + chrono::seconds(secs);
+
+  if (e.failures == ENDPOINT_FAILURES) LOG_INFO << "Passing over endpoint " << e.url << " for " << secs << "s.";
+}
+
+bool Endpoints::isHealthy(const Endpoint& e) const
+{
+  return e.failures < ENDPOINT_FAILURES || Clock::now() >= e.downUntil;
+}
+
+/**
+ * Splits ws[s]://host[:port][/path] into host and port; IPv6 hosts are
+ * bracketed.
+ */
+bool Endpoints::parseUrl(const string& url, string& host, string& port)
+{
+  size_t start;
+  if (url.compare(0, 6, "wss://") == 0) {
+    start = 6;
+    port = "443";
+  }
+  else if (url.compare(0, 5, "ws://") == 0) {
+    start = 5;
+    port = "80";
+  }
+  else {
+    return false;
+  }
+
+  size_t end = url.find('/', start);
+  string authority = url.substr(start, end == string::npos ? string::npos : end - start);
+
+  size_t colon = authority.rfind(':');
+  size_t bracket = authority.rfind(']');
+  if (colon != string::npos && (bracket == string::npos || colon > bracket)) {
+    port = authority.substr(colon + 1);
+    authority.resize(colon);
+  }
+
+  if (authority.size() > 2 && authority.front() == '[' && authority.back() == ']') {
+    authority = authority.substr(1, authority.size() - 2);
+  }
+
+  host = authority;
+  return !host.empty() && !port.empty();
+}
+
+// vim: set ts=2 sw=2 expandtab:
@@ -0,0 +1,93 @@
+// Spooky Scoreboard Daemon
+// Copyright (C) 2025 Greg MacKenzie
+// https://spookyscoreboard.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Probes: how long to wait for a TCP connection to an endpoint.
+#define ENDPOINT_PROBE_TIMEOUT_MS 1000
+
+// Consecutive failures before an endpoint is passed over, and for how
+// long: the cooldown doubles with each further failure, up to the max.
+#define ENDPOINT_FAILURES 3
+#define ENDPOINT_COOLDOWN 60
+#define ENDPOINT_COOLDOWN_MAX 900
+
+/**
+ * Backend URLs to choose between, ranked by health and round trip time.
+ *
+ * Round trip time is measured by timing a TCP connection to each
+ * endpoint, which is cheap enough to repeat and close to what a request
+ * sees. Failures are reported by the connection that saw them.
+ */
+class Endpoints
+{
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  /**
+   * @brief Replaces the list. Endpoints still listed keep their state.
+   */
+  void set(const std::vector<std::string>& urls);
+
+  /**
+   * @brief Measures every endpoint's round trip time, concurrently.
+   *        Endpoints that can't be reached count as failed.
+   */
+  void probe();
+
+  /**
+   * @brief Retrieves the endpoints best first: healthy before passed
+   *        over, then fastest; unmeasured ones keep their list order.
+   */
+  std::vector<std::string> ranked();
+
+  void failed(const std::string& url);
+  void succeeded(const std::string& url);
+  bool healthy(const std::string& url);
+
+  /**
+   * @brief Retrieves the smoothed round trip time in seconds, or a
+   *        negative value if unknown.
+   */
+  double rtt(const std::string& url);
+
+  size_t size();
+
+private:
+  struct Endpoint {
+    std::string url;
+    double rtt = -1;
+    int failures = 0;
+    Clock::time_point downUntil;
+  };
+
+  std::mutex mtx;
+  std::vector<Endpoint> endpoints;
+
+  Endpoint* find(const std::string& url);
+  void fail(Endpoint& e);
+  bool isHealthy(const Endpoint& e) const;
+
+  static bool parseUrl(const std::string& url, std::string& host, std::string& port);
+};
+
+// vim: set ts=2 sw=2 expandtab:
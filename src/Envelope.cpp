@@ -0,0 +1,303 @@
+// Spooky Scoreboard Daemon
+// Copyright (C) 2025 Greg MacKenzie
+// https://spookyscoreboard.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <cstdlib>
+#include <cstring>
+
+#include "Envelope.h"
+
+using namespace std;
+
+namespace
+{
+  class Scanner
+  {
+  public:
+    Scanner(const char* begin, const char* end) : p(begin), e(end) {}
+
+    bool object(Envelope& env);
+
+  private:
+    const char* p;
+    const char* e;
+
+    void space();
+    bool literal(const char* word);
+    bool text(std::string* out);
+    bool number(int* out);
+    bool value(int depth = 1);
+    bool hex4(uint32_t& cp);
+  };
+
+  void append(std::string& out, uint32_t cp)
+  {
+    if (cp < 0x80) {
+      out += static_cast<char>(cp);
+    }
+    else if (cp < 0x800) {
+      out += static_cast<char>(0xc0 | (cp >> 6));
+      out += static_cast<char>(0x80 | (cp & 0x3f));
+    }
+    else if (cp < 0x10000) {
+      out += static_cast<char>(0xe0 | (cp >> 12));
+      out += static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+      out += static_cast<char>(0x80 | (cp & 0x3f));
+    }
+    else {
+      out += static_cast<char>(0xf0 | (cp >> 18));
+      out += static_cast<char>(0x80 | ((cp >> 12) & 0x3f));
+      out += static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+      out += static_cast<char>(0x80 | (cp & 0x3f));
+    }
+  }
+
+  void Scanner::space()
+  {
+    while (p != e && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) ++p;
+  }
+
+  bool Scanner::literal(const char* word)
+  {
+    const size_t len = strlen(word);
+    if (static_cast<size_t>(e - p) < len || memcmp(p, word, len) != 0) return false;
+    p += len;
+    return true;
+  }
+
+  bool Scanner::hex4(uint32_t& cp)
+  {
+    if (e - p < 4) return false;
+
+    cp = 0;
+    for (int i = 0; i < 4; i++, p++) {
+      const char c = *p;
+      cp <<= 4;
+      if (c >= '0' && c <= '9') cp |= static_cast<uint32_t>(c - '0');
+      else if (c >= 'a' && c <= 'f') cp |= static_cast<uint32_t>(c - 'a' + 10);
+      else if (c >= 'A' && c <= 'F') cp |= static_cast<uint32_t>(c - 'A' + 10);
+      else return false;
+    }
+
+    return true;
+  }
+
+  /**
+   * Reads a string, unescaping it into out, or skipping it if out is null.
+   */
+  bool Scanner::text(std::string* out)
+  {
+    if (p == e || *p != '"') return false;
+    ++p;
+
+    while (p != e) {
+      // Copy runs without escapes in one go.
+      const char* run = p;
+      while (p != e && *p != '"' && *p != '\\') ++p;
+      if (out) out->append(run, p);
+
+      if (p == e) return false;
+      if (*p++ == '"') return true;
+      if (p == e) return false;
+
+      const char c = *p++;
+      char unescaped;
+
+      switch (c) {
+      case '"': unescaped = '"'; break;
+      case '\\': unescaped = '\\'; break;
+      case '/': unescaped = '/'; break;
+      case 'b': unescaped = '\b'; break;
+      case 'f': unescaped = '\f'; break;
+      case 'n': unescaped = '\n'; break;
+      case 'r': unescaped = '\r'; break;
+      case 't': unescaped = '\t'; break;
+      case 'u': {
+        uint32_t cp;
+        if (!hex4(cp)) return false;
+
+        // A surrogate pair encodes one code point; unpaired halves
+        // aren't valid.
+        if (cp >= 0xdc00 && cp < 0xe000) return false;
+
+        if (cp >= 0xd800 && cp < 0xdc00) {
+          if (e - p < 6 || p[0] != '\\' || p[1] != 'u') return false;
+          p += 2;
+          uint32_t low;
+          if (!hex4(low) || low < 0xdc00 || low >= 0xe000) return false;
+          cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+        }
+
+        if (out) append(*out, cp);
+        continue;
+      }
+      default:
+        return false;
+      }
+
+      if (out) *out += unescaped;
+    }
+
+    return false;
+  }
+
+  bool Scanner::number(int* out)
+  {
+    const char* start = p;
+    if (p != e && *p == '-') ++p;
+    while (p != e && ((*p >= '0' && *p <= '9') || *p == '.' || *p == 'e' || *p == 'E' ||
+                      *p == '+' || *p == '-')) {
+      ++p;
+    }
+
+    if (p == start) return false;
+    if (out) *out = static_cast<int>(strtol(start, nullptr, 10));
+    return true;
+  }
+
+  /**
+   * Skips a value of any type, nested at most ENVELOPE_MAX_DEPTH deep.
+   */
+  bool Scanner::value(int depth)
+  {
+    space();
+    if (p == e) return false;
+
+    switch (*p) {
+    case '"':
+      return text(nullptr);
+
+    case '{':
+    case '[': {
+      if (depth >= ENVELOPE_MAX_DEPTH) return false;
+
+      const char close = *p == '{' ? '}' : ']';
+      ++p;
+      space();
+      if (p != e && *p == close) {
+        ++p;
+        return true;
+      }
+
+      while (true) {
+        if (close == '}') {
+          space();
+          if (!text(nullptr)) return false;
+          space();
+          if (p == e || *p++ != ':') return false;
+        }
+
+        if (!value(depth + 1)) return false;
+        space();
+
+        if (p == e) return false;
+        if (*p == ',') {
+          ++p;
+          continue;
+        }
+        if (*p++ == close) return true;
+        return false;
+      }
+    }
+
+    case 't': return literal("true");
+    case 'f': return literal("false");
+    case 'n': return literal("null");
+
+    default:
+      return number(nullptr);
+    }
+  }
+
+  bool Scanner::object(Envelope& env)
+  {
+    std::string key;
+
+    space();
+    if (p == e || *p++ != '{') return false;
+
+    space();
+    if (p != e && *p == '}') return true;
+
+    while (true) {
+      space();
+      key.clear();
+      if (!text(&key)) return false;
+
+      space();
+      if (p == e || *p++ != ':') return false;
+      space();
+
+      std::string* field = nullptr;
+      if (key == "request_id") field = &env.requestId;
+      else if (key == "uuid") field = &env.uuid;
+      else if (key == "cmd") field = &env.cmd;
+      else if (key == "body") field = &env.body;
+
+      const bool isString = p != e && *p == '"';
+
+      if (field && isString) {
+        field->clear();
+        if (!text(field)) return false;
+      }
+      else if (key == "status" && !isString) {
+        if (!number(&env.status)) return false;
+      }
+      else if (key == "body") {
+        const char* start = p;
+        if (!value()) return false;
+        env.body.assign(start, p);
+      }
+      else if (!value()) {
+        return false;
+      }
+
+      space();
+      if (p == e) return false;
+      if (*p == ',') {
+        ++p;
+        continue;
+      }
+      return *p == '}';
+    }
+  }
+}
+
+bool Envelope::scan(const std::string& text)
+{
+  return Scanner(text.data(), text.data() + text.size()).object(*this);
+}
+
+void Envelope::from(const Json::Value& msg)
+{
+  if (!msg.isObject()) return;
+
+  auto str = [&](const char* key) {
+    const Json::Value& v = msg[key];
+    return v.isString() ? v.asString() : std::string();
+  };
+
+  requestId = str("request_id");
+  uuid = str("uuid");
+  cmd = str("cmd");
+  status = msg["status"].isIntegral() ? msg["status"].asInt() : 0;
+
+  const Json::Value& b = msg["body"];
+  if (b.isString()) body = b.asString();
+  else if (!b.isNull()) body = Json::FastWriter().write(b);
+}
+
+// vim: set ts=2 sw=2 expandtab:
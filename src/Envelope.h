@@ -0,0 +1,55 @@
+// Spooky Scoreboard Daemon
+// Copyright (C) 2025 Greg MacKenzie
+// https://spookyscoreboard.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <string>
+
+#include <json/json.h>
+
+// Deepest nesting scan() will skip through, as for CBOR frames.
+#define ENVELOPE_MAX_DEPTH 32
+
+/**
+ * The top-level fields of an incoming message that decide where it goes.
+ *
+ * scan() finds them in JSON text with a single pass that builds no DOM,
+ * so a message is only fully parsed if its handler needs more.
+ */
+struct Envelope
+{
+  std::string requestId;
+  std::string uuid;
+  std::string cmd;
+  int status = 0;
+
+  // The response body. The server sends it as a string; anything else
+  // is kept as its JSON text.
+  std::string body;
+
+  /**
+   * @return False if the text isn't a JSON object.
+   */
+  bool scan(const std::string& text);
+
+  /**
+   * @brief Takes the fields from an already decoded message.
+   */
+  void from(const Json::Value& msg);
+};
+
+// vim: set ts=2 sw=2 expandtab:
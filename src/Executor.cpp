@@ -0,0 +1,154 @@
+// Spooky Scoreboard Daemon
+// Copyright (C) 2025 Greg MacKenzie
+// https://spookyscoreboard.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <csignal>
+#include <cstdlib>
+#include <stdexcept>
+
+#include <pthread.h>
+
+#include "Executor.h"
+#include "Log.h"
+#include "Metrics.h"
+
+using namespace std;
+
+namespace
+{
+  Metrics::Counter& inlined = Metrics::counter(
+    "ssbd_executor_inline_total", "Tasks run by the poster because the executor's queue was full.");
+}
+
+Executor::Executor() : worker(&Executor::run, this) {}
+
+Executor::~Executor()
+{
+  stop();
+}
+
+void Executor::post(Task task)
+{
+  if (!running.load()) return;
+
+  if (!queue.produce([&task](Task& cell) { cell = move(task); })) {
+    LOG_WARNING << "Executor queue full, running task inline.";
+    inlined.inc();
+    task();
+    return;
+  }
+
+  // Taking the lock orders this with the worker's check of the queue,
+  // so the wakeup can't slip in between the check and the wait.
+  { lock_guard<mutex> lock(mtx); }
+  cv.notify_one();
+}
+
+void Executor::schedule(Clock::duration delay, Task task)
+{
+  if (!running.load()) return;
+
+  {
+    lock_guard<mutex> lock(mtx);
+    timers.push_back({Clock::now() + delay, scheduled++, move(task)});
+    push_heap(timers.begin(), timers.end(), greater<Timer>());
+  }
+  cv.notify_one();
+}
+
+void Executor::stop()
+{
+  if (!running.exchange(false)) return;
+
+  { lock_guard<mutex> lock(mtx); }
+  cv.notify_one();
+
+  if (!worker.joinable()) return;
+
+  // The owner goes away once this returns, so the worker must not be
+  // left running; it can't wait for itself.
+  if (worker.get_id() == this_thread::get_id()) {
+    LOG_ERROR << "Executor stopped from its own task.";
+    abort();
+  }
+  worker.join();
+
+  // Pending timers may own resources whose callbacks reach back into
+  // the owner; release them now rather than with the executor.
+  vector<Timer> dropped;
+  {
+    lock_guard<mutex> lock(mtx);
+    dropped.swap(timers);
+  }
+}
+
+void Executor::run()
+{
+  // Signal handlers exit, which would stop the executor from its own
+  // thread; leave them to the others.
+  sigset_t signals;
+  sigfillset(&signals);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+  vector<Task> due;
+
+  while (running.load()) {
+    {
+      unique_lock<mutex> lock(mtx);
+
+      while (running.load() && queue.empty()) {
+        if (timers.empty()) cv.wait(lock);
+        else if (timers.front().due <= Clock::now()) break;
+        else cv.wait_until(lock, timers.front().due);
+      }
+
+      const auto now = Clock::now();
+      while (!timers.empty() && timers.front().due <= now) {
+        pop_heap(timers.begin(), timers.end(), greater<Timer>());
+        due.push_back(move(timers.back().task));
+        timers.pop_back();
+      }
+    }
+
+    for (auto& task : due) execute(task);
+    due.clear();
+
+    drain();
+  }
+  drain();
+}
+
+void Executor::execute(Task& task)
+{
+  try {
+    task();
+  }
+  catch (const exception& e) {
+    LOG_ERROR << "Task failed: " << e.what();
+  }
+}
+
+void Executor::drain()
+{
+  Task task;
+  while (queue.pop(task)) {
+    execute(task);
+    task = nullptr;
+  }
+}
+
+// vim: set ts=2 sw=2 expandtab:
@@ -0,0 +1,102 @@
+// Spooky Scoreboard Daemon
+// Copyright (C) 2025 Greg MacKenzie
+// https://spookyscoreboard.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "RingBuffer.h"
+
+// Tasks queued before posting falls back to running them inline.
+#define EXECUTOR_QUEUE_SIZE 256
+
+/**
+ * Runs tasks in order on a single worker thread.
+ *
+ * Tasks are handed over through a lock-free queue, so posting never
+ * waits on a task that is running. Delayed tasks are rare and kept in
+ * a heap under the lock.
+ */
+class Executor
+{
+public:
+  typedef std::function<void()> Task;
+  typedef std::chrono::steady_clock Clock;
+
+  Executor();
+  ~Executor();
+
+  Executor(const Executor&) = delete;
+  Executor& operator=(const Executor&) = delete;
+
+  /**
+   * @brief Queues a task. If the queue is full, the task runs now on
+   *        the calling thread rather than being lost. Tasks posted
+   *        after the executor stops are dropped.
+   */
+  void post(Task task);
+
+  /**
+   * @brief Runs a task once a delay has passed. Delayed tasks still
+   *        pending when the executor stops, or scheduled after, are
+   *        dropped.
+   */
+  void schedule(Clock::duration delay, Task task);
+
+  /**
+   * @brief Runs the tasks already queued, then stops the worker. Must
+   *        not be called from a task.
+   */
+  void stop();
+
+private:
+  RingBuffer<Task, EXECUTOR_QUEUE_SIZE> queue;
+
+  std::atomic<bool> running{true};
+  std::mutex mtx;
+  std::condition_variable cv;
+
+  struct Timer {
+    Clock::time_point due;
+    uint64_t order;
+    Task task;
+
+    // Earliest first, then in the order scheduled.
+    bool operator>(const Timer& other) const
+    {
+      return due != other.due ? due > other.due : order > other.order;
+    }
+  };
+
+  std::vector<Timer> timers;
+  uint64_t scheduled = 0;
+
+  // Last, so it starts once everything it uses is constructed.
+  std::thread worker;
+
+  void run();
+  void drain();
+  void execute(Task& task);
+};
+
+// vim: set ts=2 sw=2 expandtab:
@@ -15,10 +15,12 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
-#include <iostream>
+#include <algorithm>
+#include <fstream>
 #include <map>
 
-#include "main.h"
+#include <yaml-cpp/yaml.h>
+
 #include "GameBase.h"
 
 #include "game/EvilDead.h"
@@ -27,6 +29,8 @@
 #include "game/TotalNuclearAnnihilation.h"
 #include "game/Ultraman.h"
 #include "game/AliceCooperNightmareCastle.h"
+#include "Log.h"
+#include "Trace.h"
 
 using namespace std;
 
@@ -50,33 +54,78 @@ std::unique_ptr<GameBase> GameBase::create(const std::string& gameName)
   return nullptr;
 }
 
-void GameBase::uploadScores(const Json::Value& scores, ScoreType type)
+GameBase::Audits GameBase::parseJsonAudits(const string& path)
+{
+  ifstream ifs(path);
+  if (!ifs.is_open()) {
+    throw runtime_error("Failed to open game audits file");
+  }
+
+  Json::Value root;
+  Json::CharReaderBuilder builder;
+  JSONCPP_STRING errs;
+
+  if (!parseFromStream(builder, ifs, &root, &errs) || !root.isObject()) {
+    throw runtime_error("Failed to read audits file");
+  }
+
+  Audits audits;
+  for (const auto& name : root.getMemberNames()) {
+    const Json::Value& value = root[name].isObject() ? root[name]["value"] : root[name];
+    if (value.isIntegral()) audits.emplace_back(name, value.asInt64());
+  }
+
+  // getMemberNames() is already sorted.
+  return audits;
+}
+
+GameBase::Audits GameBase::parseYamlAudits(const string& path)
 {
-  cout << "Uploading scores..." << endl;
+  YAML::Node node;
 
   try {
-    Json::Value req;
+    node = YAML::LoadFile(path)["Audits"];
+  }
+  catch (const YAML::Exception& e) {
+    throw runtime_error("Failed to load audits from YAML file.");
+  }
+
+  Audits audits;
+  if (!node.IsMap()) return audits;
+
+  for (const auto& it : node) {
+    int64_t value;
+    if (YAML::convert<int64_t>::decode(it.second, value)) {
+      audits.emplace_back(it.first.as<string>(), value);
+    }
+  }
 
+  sort(audits.begin(), audits.end());
+  return audits;
+}
+
+void GameBase::uploadScores(WebSocket& ws, const Json::Value& scores, ScoreType type)
+{
+  LOG_INFO << "Uploading scores...";
+  Trace::Span span("upload");
+
+  try {
     string query = "type=";
     switch (type) {
     case ScoreType::High: query += "classic"; break;
     case ScoreType::Last: query += "last"; break;
     case ScoreType::Mode: query += "mode"; break;
+    case ScoreType::Bundle: query += "bundle"; break;
     }
 
-    req["path"] = "/api/v1/score";
-    req["method"] = "POST";
-    req["query"] = query;
-    req["body"] = scores;
-
-    webSocket->send(req, [this](const Json::Value& response) {
-      if (response["status"].asInt() != 200) {
-        cerr << "Failed to upload scores." << endl;
+    ws.send({"/api/v1/score", "POST", &scores, query}, [this](const WebSocket::Response& response) {
+      if (response.status != 200) {
+        LOG_ERROR << "Failed to upload scores.";
       }
     });
   }
   catch (const runtime_error& e) {
-    cerr << "Exception: " << e.what() << endl;
+    LOG_ERROR << "Exception: " << e.what();
   }
 
 }
@@ -20,6 +20,8 @@
 #include <string>
 #include <memory>
 #include <functional>
+#include <utility>
+#include <vector>
 
 #include <X11/Xlib.h>
 #include <json/json.h>
@@ -30,9 +32,9 @@ class GameBase
 {
 protected:
   const std::string gameName;
-  const std::string gamePath;
-  const std::string scoresPath;
-  const std::string tmpPath;
+  std::string gamePath;
+  std::string scoresPath;
+  std::string tmpPath;
   const std::string highScoresFile;
   const std::string lastScoresFile;
   const std::string auditsFile;
@@ -58,11 +60,49 @@ public:
 
   static std::unique_ptr<GameBase> create(const std::string& gameName);
 
-  enum class ScoreType { High, Last, Mode };
-  void uploadScores(const Json::Value& scores, ScoreType type);
+  // Bundle: {"last": ..., "high": ..., "audits": ...}, any of them;
+  // audits as {"delta": ...} or {"full": ...}, see ScoreWatcher.
+  enum class ScoreType { High, Last, Mode, Bundle };
+
+  /**
+   * @brief Sends scores to the server.
+   *
+   * @param ws The machine's server connection.
+   * @param scores Scores as returned by the process functions.
+   * @param type Which scores these are.
+   */
+  void uploadScores(WebSocket& ws, const Json::Value& scores, ScoreType type);
+
+  /**
+   * @brief Moves the game's directories under a new root.
+   *
+   * Lets the parsers run against a copy of a cabinet's file system,
+   * e.g. for benchmarks or development away from the machine.
+   *
+   * @param root Directory prepended to the game, scores and tmp paths.
+   */
+  void relocate(const std::string& root)
+  {
+    gamePath = root + gamePath;
+    scoresPath = root + scoresPath;
+    tmpPath = root + tmpPath;
+  }
+
+  // Audit counters by name, sorted by name.
+  using Audits = std::vector<std::pair<std::string, int64_t>>;
 
   virtual uint32_t getGamesPlayed() = 0;
 
+  /**
+   * @brief Process audits.
+   *
+   * The derived game class must override this function, returning every
+   * numeric counter in the game's audits.
+   *
+   * @return Audit counters, sorted by name.
+   */
+  virtual Audits processAudits() = 0;
+
   /**
    * @brief Process highscores.
    *
@@ -143,6 +183,17 @@ public:
    * @return 0 on success, negative value on failure.
    */
   virtual int sendWindowCommands() { return 0; }
+
+protected:
+  /**
+   * @brief Reads audits kept as {"name": {"label": ..., "value": N}, ...}.
+   */
+  static Audits parseJsonAudits(const std::string& path);
+
+  /**
+   * @brief Reads the "Audits" map of a YAML game data file.
+   */
+  static Audits parseYamlAudits(const std::string& path);
 };
 
 using GameFactoryFunction = std::function<std::unique_ptr<GameBase>()>;
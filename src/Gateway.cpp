@@ -0,0 +1,275 @@
+// Spooky Scoreboard Daemon
+// Copyright (C) 2025 Greg MacKenzie
+// https://spookyscoreboard.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <stdexcept>
+
+#include <uuid/uuid.h>
+
+#include "Gateway.h"
+#include "Log.h"
+#include "Metrics.h"
+
+using namespace std;
+
+namespace
+{
+  Metrics::Gauge& cabinets = Metrics::gauge(
+    "ssbd_gateway_clients", "Cabinets connected through the gateway.");
+  Metrics::Counter& relayed = Metrics::counter(
+    "ssbd_gateway_relayed_total", "Requests relayed upstream for other cabinets.");
+  Metrics::Counter& refused = Metrics::counter(
+    "ssbd_gateway_refused_total", "Relayed requests refused while the server was unreachable.");
+  Metrics::Counter& rejected = Metrics::counter(
+    "ssbd_gateway_rejected_total", "Cabinets turned away for missing credentials or secret.");
+
+  const char* bearer = "Bearer ";
+}
+
+Gateway::Gateway(const Options& opts, const shared_ptr<WebSocket>& ws) :
+  options(opts),
+  server(opts.port, opts.host),
+  upstream(ws)
+{
+  if (options.secret.empty() && options.certFile.empty()) {
+    throw runtime_error("Gateway needs a secret or a certificate (\"relay\" in .ssbd.json).");
+  }
+
+  if (!options.certFile.empty()) {
+    ix::SocketTLSOptions tls;
+    tls.tls = true;
+    tls.certFile = options.certFile;
+    tls.keyFile = options.keyFile;
+    tls.caFile = "NONE";
+    server.setTLSOptions(tls);
+  }
+
+  server.setOnClientMessageCallback([this](shared_ptr<ix::ConnectionState>,
+                                           ix::WebSocket& client,
+                                           const ix::WebSocketMessagePtr& msg) {
+    onMessage(client, msg);
+  });
+}
+
+Gateway::~Gateway()
+{
+  stop();
+}
+
+void Gateway::start()
+{
+  auto res = server.listen();
+  if (!res.first) throw runtime_error("Gateway failed to listen: " + res.second);
+
+  upstream->setRelayHandler([this](const Json::Value& json) { onUpstream(json); });
+
+  server.start();
+  running = true;
+  LOG_INFO << "Gateway started.";
+}
+
+void Gateway::stop()
+{
+  if (!running) return;
+  running = false;
+
+  upstream->setRelayHandler(nullptr);
+  server.stop();
+}
+
+void Gateway::onMessage(ix::WebSocket& client, const ix::WebSocketMessagePtr& msg)
+{
+  switch (msg->type) {
+  case ix::WebSocketMessageType::Open: {
+    Client c;
+
+    if (!admit(msg->openInfo.headers, c)) {
+      LOG_WARNING << "Gateway: refused a cabinet without valid credentials.";
+      rejected.inc();
+      client.close(4001, "Unauthorized");
+      break;
+    }
+
+    LOG_INFO << "Gateway: cabinet " << c.machineId << " connected.";
+
+    lock_guard<mutex> lock(mtx);
+    clients[&client] = c;
+    cabinets.add();
+    break;
+  }
+
+  case ix::WebSocketMessageType::Close: {
+    lock_guard<mutex> lock(mtx);
+    if (clients.erase(&client)) cabinets.sub();
+    break;
+  }
+
+  case ix::WebSocketMessageType::Message: {
+    Json::Value req;
+    if (Json::Reader().parse(msg->str, req) && req.isObject()) {
+      onRequest(client, req);
+    }
+    break;
+  }
+
+  default:
+    break;
+  }
+}
+
+/**
+ * Checks a cabinet's handshake: it must present the gateway's secret,
+ * if one is set, and its own UUID and token.
+ */
+bool Gateway::admit(const ix::WebSocketHttpHeaders& headers, Client& c) const
+{
+  if (!options.secret.empty()) {
+    auto it = headers.find("X-Gateway-Secret");
+    if (it == headers.end() || it->second.size() != options.secret.size()) return false;
+
+    // Compare in constant time.
+    unsigned char diff = 0;
+    for (size_t i = 0; i < options.secret.size(); i++) {
+      diff |= static_cast<unsigned char>(it->second[i] ^ options.secret[i]);
+    }
+    if (diff != 0) return false;
+  }
+
+  auto it = headers.find("X-Machine-Uuid");
+  if (it != headers.end()) c.machineId = it->second;
+
+  it = headers.find("Authorization");
+  if (it != headers.end() && it->second.compare(0, 7, bearer) == 0) {
+    c.token = it->second.substr(7);
+  }
+
+  return !c.machineId.empty() && !c.token.empty();
+}
+
+/**
+ * Relays a cabinet's request upstream, tagged with its credentials.
+ * Credentials in the request itself are never trusted.
+ */
+void Gateway::onRequest(ix::WebSocket& client, Json::Value req)
+{
+  const string reqid = req["request_id"].asString();
+
+  // Cabinets choose their own ids, so they may collide; the request
+  // goes upstream under one the gateway assigns.
+  char relayId[37] = {};
+  if (!reqid.empty()) {
+    uuid_t uuid;
+    uuid_generate_random(uuid);
+    uuid_unparse_lower(uuid, relayId);
+    req["request_id"] = relayId;
+  }
+
+  {
+    lock_guard<mutex> lock(mtx);
+    auto it = clients.find(&client);
+    if (it == clients.end()) return;
+
+    req["uuid"] = it->second.machineId;
+    req["token"] = it->second.token;
+
+    if (!reqid.empty()) {
+      pruneRoutes();
+      routes[relayId] = {&client, it->second.machineId, reqid, Clock::now()};
+    }
+  }
+
+  relayed.inc();
+  if (upstream->relay(req)) return;
+
+  refused.inc();
+
+  if (!reqid.empty()) {
+    {
+      lock_guard<mutex> lock(mtx);
+      routes.erase(relayId);
+    }
+
+    Json::Value resp;
+    resp["request_id"] = reqid;
+    resp["status"] = 503;
+    resp["body"] = "{\"message\":\"Server unreachable.\"}";
+    reply(client, resp);
+  }
+}
+
+/**
+ * Routes a response or server command back to the cabinet it's for.
+ * A cabinet that reconnected since its request is found by UUID.
+ */
+void Gateway::onUpstream(const Json::Value& json)
+{
+  lock_guard<mutex> lock(mtx);
+  ix::WebSocket* client = nullptr;
+
+  if (json.isMember("request_id")) {
+    auto it = routes.find(json["request_id"].asString());
+    if (it == routes.end()) {
+      LOG_ERROR << "Gateway: response to unknown request.";
+      return;
+    }
+
+    if (clients.count(it->second.client)) client = it->second.client;
+    else client = findClient(it->second.machineId);
+
+    Json::Value resp = json;
+    resp["request_id"] = it->second.requestId;
+    routes.erase(it);
+
+    if (client) reply(*client, resp);
+    return;
+  }
+
+  client = findClient(json["uuid"].asString());
+  if (client) reply(*client, json);
+}
+
+ix::WebSocket* Gateway::findClient(const string& machineId)
+{
+  if (machineId.empty()) return nullptr;
+
+  for (const auto& c : clients) {
+    if (c.second.machineId == machineId) return c.first;
+  }
+
+  return nullptr;
+}
+
+/**
+ * Forgets requests whose responses never came.
+ */
+void Gateway::pruneRoutes()
+{
+  const auto expired = Clock::now() - chrono::seconds(GATEWAY_ROUTE_TTL);
+
+  for (auto it = routes.begin(); it != routes.end(); ) {
+    if (it->second.sent < expired) it = routes.erase(it);
+    else ++it;
+  }
+}
+
+void Gateway::reply(ix::WebSocket& client, const Json::Value& msg)
+{
+  Json::StreamWriterBuilder writerBuilder;
+  writerBuilder["indentation"] = "";
+  client.send(Json::writeString(writerBuilder, msg));
+}
+
+// vim: set ts=2 sw=2 expandtab:
@@ -0,0 +1,115 @@
+// Spooky Scoreboard Daemon
+// Copyright (C) 2025 Greg MacKenzie
+// https://spookyscoreboard.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <ixwebsocket/IXWebSocketServer.h>
+#include <json/json.h>
+
+#include "WebSocket.h"
+
+// Forget where a relayed request came from after this long.
+#define GATEWAY_ROUTE_TTL 600
+
+/**
+ * Lets the other cabinets at a venue share this machine's connection.
+ *
+ * Cabinets connect with -w ws[s]://GATEWAY:PORT. Their requests are
+ * relayed upstream tagged with their machine UUID and token and under
+ * a request id the gateway assigns. Responses are routed back by that
+ * id, and server commands by machine UUID.
+ * Uploads wait in the shared outbox while the server is unreachable.
+ *
+ * Cabinets must be registered and present the gateway's secret
+ * (X-Gateway-Secret, from "gateway_secret" in their config, sent only
+ * to the endpoint matching "gateway_url"); others are refused. Tokens cross the LAN in cleartext unless the gateway serves
+ * wss:// with a certificate the cabinets trust.
+ *
+ * The backend must accept "uuid" and "token" in the body of a relayed
+ * request as the credentials of the machine it's from, in place of
+ * those of the connection it arrives on.
+ */
+class Gateway
+{
+public:
+  struct Options {
+    std::string host = "127.0.0.1";
+    int port = 0;
+
+    // Secret cabinets must present; required unless serving wss://.
+    std::string secret;
+
+    // Certificate and key to serve wss:// with.
+    std::string certFile;
+    std::string keyFile;
+  };
+
+  Gateway(const Options& opts, const std::shared_ptr<WebSocket>& ws);
+  ~Gateway();
+
+  /**
+   * @brief Starts listening. Throws runtime_error on failure.
+   */
+  void start();
+  void stop();
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  // A cabinet connected to the gateway.
+  struct Client {
+    std::string machineId;
+    std::string token;
+  };
+
+  // Where to send the response to a relayed request, and the id the
+  // cabinet gave it.
+  struct Route {
+    ix::WebSocket* client;
+    std::string machineId;
+    std::string requestId;
+    Clock::time_point sent;
+  };
+
+  Options options;
+  ix::WebSocketServer server;
+  const std::shared_ptr<WebSocket> upstream;
+  bool running = false;
+
+  std::mutex mtx;
+  std::map<ix::WebSocket*, Client> clients;
+  // Keyed by the request id the gateway assigned.
+  std::map<std::string, Route> routes;
+
+  void onMessage(ix::WebSocket& client, const ix::WebSocketMessagePtr& msg);
+  void onRequest(ix::WebSocket& client, Json::Value req);
+  void onUpstream(const Json::Value& json);
+  ix::WebSocket* findClient(const std::string& machineId);
+  void pruneRoutes();
+
+  bool admit(const ix::WebSocketHttpHeaders& headers, Client& c) const;
+
+  static void reply(ix::WebSocket& client, const Json::Value& msg);
+};
+
+// vim: set ts=2 sw=2 expandtab:
@@ -0,0 +1,284 @@
+// Spooky Scoreboard Daemon
+// Copyright (C) 2025 Greg MacKenzie
+// https://spookyscoreboard.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <cstring>
+#include <cerrno>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <json/json.h>
+
+#include "I3Ipc.h"
+#include "Log.h"
+
+#define I3_IPC_MAGIC "i3-ipc"
+#define I3_IPC_MAGIC_LEN 6
+#define I3_IPC_HEADER_LEN (I3_IPC_MAGIC_LEN + 8)
+
+// Criteria matching all scoreboard windows (see openWindows()).
+#define I3_SSB_CRITERIA "[title=\"^(Player [1-4]|Spooky Scoreboard Message)$\"]"
+
+using namespace std;
+
+I3Ipc::I3Ipc(const char* env, const string& title) :
+  socketEnv(env),
+  gameTitle(title) {}
+
+I3Ipc::~I3Ipc()
+{
+  subscribed.store(false);
+  if (eventSocket >= 0) shutdown(eventSocket, SHUT_RDWR);
+  if (eventThread.joinable()) eventThread.join();
+  closeSockets();
+}
+
+int I3Ipc::applyRules()
+{
+  // Steady state; new windows are handled by the event thread.
+  if (subscribed.load()) return 0;
+
+  lock_guard<mutex> lock(cmdMtx);
+  if (subscribed.load()) return 0;
+
+  // A previous subscription died (e.g. the window manager restarted).
+  if (eventThread.joinable()) eventThread.join();
+  closeSockets();
+
+  // All rules go out in a single message; i3 resets criteria after ';'.
+  string cmds =
+    "[title=\"" + gameTitle + "\"] border none; "
+    I3_SSB_CRITERIA " floating enable; "
+    I3_SSB_CRITERIA " sticky enable; "
+    I3_SSB_CRITERIA " border none; "
+    I3_SSB_CRITERIA " focus";
+
+  if ((cmdSocket = openSocket()) < 0) return -1;
+  if (runCommand(cmds) < 0) return -1;
+
+  if ((eventSocket = openSocket()) < 0) return -1;
+  if (subscribe() < 0) return -1;
+
+  subscribed.store(true);
+  eventThread = thread(&I3Ipc::watchEvents, this);
+  return 0;
+}
+
+int I3Ipc::openSocket()
+{
+  const char* path = getenv(socketEnv);
+  if (!path) {
+    LOG_ERROR << socketEnv << " environment variable not set";
+    return -1;
+  }
+
+  int sd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (sd < 0) {
+    LOG_ERROR << "Failed to create socket";
+    return -1;
+  }
+
+  struct sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+  if (connect(sd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+    LOG_ERROR << "Failed to connect to " << path;
+    close(sd);
+    return -1;
+  }
+
+  return sd;
+}
+
+/**
+ * Runs one or more commands and checks every reply.
+ * Caller must hold cmdMtx.
+ */
+int I3Ipc::runCommand(const string& cmds)
+{
+  uint32_t type;
+  string reply;
+
+  if (sendMessage(cmdSocket, RunCommand, cmds) < 0 ||
+      readMessage(cmdSocket, type, reply) < 0 ||
+      type != RunCommand) {
+
+    LOG_ERROR << "Failed sending window commands";
+    close(cmdSocket);
+    cmdSocket = -1;
+    return -1;
+  }
+
+  Json::Value results;
+  if (!Json::Reader().parse(reply, results) || !results.isArray()) {
+    LOG_ERROR << "Invalid window command reply";
+    return -1;
+  }
+
+  int rc = 0;
+  for (const auto& result : results) {
+    if (!result["success"].asBool()) {
+      LOG_ERROR << "Window command failed: " << result["error"].asString();
+      rc = -1;
+    }
+  }
+
+  return rc;
+}
+
+int I3Ipc::subscribe()
+{
+  uint32_t type;
+  string reply;
+
+  if (sendMessage(eventSocket, Subscribe, "[\"window\"]") < 0 ||
+      readMessage(eventSocket, type, reply) < 0 ||
+      type != Subscribe) {
+
+    LOG_ERROR << "Failed subscribing to window events";
+    return -1;
+  }
+
+  Json::Value result;
+  if (!Json::Reader().parse(reply, result) || !result["success"].asBool()) {
+    LOG_ERROR << "Window event subscription rejected";
+    return -1;
+  }
+
+  return 0;
+}
+
+/**
+ * Applies rules to each scoreboard window once, as the window manager
+ * starts managing it. Runs in a dedicated thread.
+ */
+void I3Ipc::watchEvents()
+{
+  uint32_t type;
+  string payload;
+
+  while (subscribed.load()) {
+    if (readMessage(eventSocket, type, payload) < 0) break;
+    if (type != WindowEvent) continue;
+
+    Json::Value evt;
+    if (!Json::Reader().parse(payload, evt)) continue;
+
+    const string& change = evt["change"].asString();
+    if (change != "new" && change != "title") continue;
+
+    const Json::Value& con = evt["container"];
+    const string& title = con["name"].asString();
+    const string criteria = "[con_id=" + to_string(con["id"].asUInt64()) + "]";
+
+    string cmds;
+    if (isScoreboardTitle(title)) {
+      cmds = criteria + " floating enable, sticky enable, border none, focus";
+    }
+    else if (title.find(gameTitle) != string::npos) {
+      cmds = criteria + " border none";
+    }
+    else {
+      continue;
+    }
+
+    lock_guard<mutex> lock(cmdMtx);
+    if (cmdSocket < 0 && (cmdSocket = openSocket()) < 0) continue;
+    runCommand(cmds);
+  }
+
+  // Resubscribe on the next applyRules() call.
+  subscribed.store(false);
+}
+
+void I3Ipc::closeSockets()
+{
+  if (cmdSocket >= 0) {
+    close(cmdSocket);
+    cmdSocket = -1;
+  }
+
+  if (eventSocket >= 0) {
+    close(eventSocket);
+    eventSocket = -1;
+  }
+}
+
+bool I3Ipc::isScoreboardTitle(const string& title)
+{
+  if (title == "Spooky Scoreboard Message") return true;
+
+  return title.size() == 8 &&
+         title.compare(0, 7, "Player ") == 0 &&
+         title[7] >= '1' && title[7] <= '4';
+}
+
+/**
+ * Writes an i3-ipc message. Length and type are in native byte order.
+ */
+int I3Ipc::sendMessage(int sd, uint32_t type, const string& payload)
+{
+  string msg(I3_IPC_MAGIC);
+  uint32_t len = static_cast<uint32_t>(payload.size());
+
+  msg.append(reinterpret_cast<const char*>(&len), 4);
+  msg.append(reinterpret_cast<const char*>(&type), 4);
+  msg.append(payload);
+
+  size_t off = 0;
+  while (off < msg.size()) {
+    ssize_t n = write(sd, msg.data() + off, msg.size() - off);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return -1;
+    off += static_cast<size_t>(n);
+  }
+
+  return 0;
+}
+
+/**
+ * Reads one complete i3-ipc message, reply or event.
+ */
+int I3Ipc::readMessage(int sd, uint32_t& type, string& payload)
+{
+  auto readFull = [sd](char* buf, size_t len) -> int {
+    size_t off = 0;
+    while (off < len) {
+      ssize_t n = read(sd, buf + off, len - off);
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) return -1;
+      off += static_cast<size_t>(n);
+    }
+    return 0;
+  };
+
+  char hdr[I3_IPC_HEADER_LEN];
+  if (readFull(hdr, sizeof(hdr)) < 0) return -1;
+  if (memcmp(hdr, I3_IPC_MAGIC, I3_IPC_MAGIC_LEN) != 0) return -1;
+
+  uint32_t len;
+  memcpy(&len, hdr + I3_IPC_MAGIC_LEN, 4);
+  memcpy(&type, hdr + I3_IPC_MAGIC_LEN + 4, 4);
+
+  payload.resize(len);
+  if (len > 0 && readFull(&payload[0], len) < 0) return -1;
+
+  return 0;
+}
+
+// vim: set ts=2 sw=2 expandtab:
@@ -0,0 +1,91 @@
+// Spooky Scoreboard Daemon
+// Copyright (C) 2025 Greg MacKenzie
+// https://spookyscoreboard.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <string>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Persistent client for the i3/sway IPC protocol.
+ *
+ * A command connection stays open for the lifetime of the game, and a
+ * second connection subscribes to window events so rules are applied
+ * once when a scoreboard window appears rather than on every show.
+ */
+class I3Ipc
+{
+public:
+  /**
+   * @brief Construct an i3-ipc client.
+   *
+   * No connection is made until applyRules() is first called.
+   *
+   * @param socketEnv Environment variable holding the IPC socket path
+   *                  (e.g. I3_SOCKET_PATH or SWAYSOCK).
+   * @param gameTitle Title of the game window, used to strip its border.
+   */
+  I3Ipc(const char* socketEnv, const std::string& gameTitle);
+
+  /**
+   * @brief Closes both IPC connections and stops the event thread.
+   */
+  ~I3Ipc();
+
+  /**
+   * @brief Applies window rules to the game and scoreboard windows.
+   *
+   * The first call connects, runs all rules as a single batched
+   * RUN_COMMAND and subscribes to window events. Subsequent calls
+   * return immediately while the subscription is alive.
+   *
+   * @return 0 on success, negative value on failure.
+   */
+  int applyRules();
+
+private:
+  enum MessageType : uint32_t {
+    RunCommand = 0,
+    Subscribe = 2,
+    WindowEvent = 0x80000003
+  };
+
+  const char* socketEnv;
+  const std::string gameTitle;
+
+  int cmdSocket = -1;
+  int eventSocket = -1;
+
+  std::mutex cmdMtx;
+  std::thread eventThread;
+  std::atomic<bool> subscribed{false};
+
+  int openSocket();
+  int runCommand(const std::string& cmds);
+  int subscribe();
+  void watchEvents();
+  void closeSockets();
+
+  static bool isScoreboardTitle(const std::string& title);
+  static int sendMessage(int sd, uint32_t type, const std::string& payload);
+  static int readMessage(int sd, uint32_t& type, std::string& payload);
+};
+
+// vim: set ts=2 sw=2 expandtab:
@@ -0,0 +1,150 @@
+// Spooky Scoreboard Daemon
+// Copyright (C) 2025 Greg MacKenzie
+// https://spookyscoreboard.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cstring>
+
+#include "Lanes.h"
+
+using namespace std;
+
+Lanes::Lanes()
+{
+  const auto now = Clock::now();
+
+  lanes[Interactive].max = LANE_QUEUE_MAX;
+  lanes[Interactive].bucket = {LANE_INTERACTIVE_RATE, LANE_INTERACTIVE_BURST, LANE_INTERACTIVE_BURST, now};
+  lanes[Interactive].weight = LANE_INTERACTIVE_WEIGHT;
+
+  lanes[Results].max = LANE_RESULTS_MAX;
+  lanes[Results].bucket = {LANE_RESULTS_RATE, LANE_RESULTS_BURST, LANE_RESULTS_BURST, now};
+  lanes[Results].weight = LANE_RESULTS_WEIGHT;
+
+  lanes[Telemetry].max = LANE_QUEUE_MAX;
+  lanes[Telemetry].bucket = {LANE_TELEMETRY_RATE, LANE_TELEMETRY_BURST, LANE_TELEMETRY_BURST, now};
+  lanes[Telemetry].weight = LANE_TELEMETRY_WEIGHT;
+}
+
+Lanes::Lane Lanes::classify(const char* path)
+{
+  if (strcmp(path, "/api/v1/score") == 0) return Results;
+  if (strcmp(path, "/api/v1/audits") == 0) return Telemetry;
+  return Interactive;
+}
+
+const char* Lanes::name(Lane lane)
+{
+  switch (lane) {
+  case Interactive: return "interactive";
+  case Results: return "results";
+  case Telemetry: return "telemetry";
+  default: return "unknown";
+  }
+}
+
+bool Lanes::take(Lane lane)
+{
+  Bucket& b = lanes[lane].bucket;
+  b.refill(Clock::now());
+  if (b.tokens < 1) return false;
+
+  b.tokens -= 1;
+  return true;
+}
+
+bool Lanes::push(Lane lane, Message&& msg, Message& dropped)
+{
+  State& s = lanes[lane];
+  bool room = s.queue.size() < s.max;
+
+  if (!room) {
+    dropped = move(s.queue.front());
+    s.queue.pop_front();
+  }
+
+  s.queue.push_back(move(msg));
+  return room;
+}
+
+/**
+ * Smooth weighted round robin over the lanes that have a message and a
+ * token: each gains its weight, the richest goes and pays the total.
+ */
+const Lanes::Message* Lanes::next(Lane& lane)
+{
+  const auto now = Clock::now();
+  State* pick = nullptr;
+  int total = 0;
+
+  for (auto& s : lanes) {
+    if (s.queue.empty()) continue;
+
+    s.bucket.refill(now);
+    if (s.bucket.tokens < 1) continue;
+
+    s.current += s.weight;
+    total += s.weight;
+    if (!pick || s.current > pick->current) pick = &s;
+  }
+
+  if (!pick) return nullptr;
+
+  pick->current -= total;
+  lane = static_cast<Lane>(pick - lanes.data());
+  return &pick->queue.front();
+}
+
+void Lanes::pop(Lane lane)
+{
+  State& s = lanes[lane];
+  s.bucket.tokens = max(s.bucket.tokens - 1, 0.0);
+  s.queue.pop_front();
+
+  // A lane that empties starts afresh, rather than banking credit.
+  if (s.queue.empty()) s.current = 0;
+}
+
+Lanes::Clock::duration Lanes::wait()
+{
+  const auto now = Clock::now();
+  double secs = -1;
+
+  for (auto& s : lanes) {
+    if (s.queue.empty()) continue;
+
+    s.bucket.refill(now);
+    double w = s.bucket.tokens >= 1 ? 0 : (1 - s.bucket.tokens) / s.bucket.rate;
+    if (secs < 0 || w < secs) secs = w;
+  }
+
+  return chrono::duration_cast<Clock::duration>(chrono::duration<double>(max(secs, 0.0)));
+}
+
+size_t Lanes::size() const
+{
+  size_t n = 0;
+  for (const auto& s : lanes) n += s.queue.size();
+  return n;
+}
+
+void Lanes::Bucket::refill(Clock::time_point now)
+{
+  tokens = min(burst, tokens + chrono::duration<double>(now - last).count() * rate);
+  last = now;
+}
+
+// vim: set ts=2 sw=2 expandtab:
@@ -0,0 +1,127 @@
+// Spooky Scoreboard Daemon
+// Copyright (C) 2025 Greg MacKenzie
+// https://spookyscoreboard.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <deque>
+#include <string>
+
+// Per lane: messages per second, and how many may go at once after a
+// lull.
+#define LANE_INTERACTIVE_RATE 5
+#define LANE_INTERACTIVE_BURST 10
+#define LANE_RESULTS_RATE 10
+#define LANE_RESULTS_BURST 20
+#define LANE_TELEMETRY_RATE 2
+#define LANE_TELEMETRY_BURST 10
+
+// Relative share of sending when several lanes have messages waiting.
+#define LANE_INTERACTIVE_WEIGHT 8
+#define LANE_RESULTS_WEIGHT 4
+#define LANE_TELEMETRY_WEIGHT 1
+
+// Messages held per lane; the oldest are dropped. Score uploads are
+// also held through outages, so their lane keeps more.
+#define LANE_QUEUE_MAX 100
+#define LANE_RESULTS_MAX 1000
+
+/**
+ * Outgoing messages by priority, each lane rate limited by a token
+ * bucket and the lanes sharing the connection by weight.
+ *
+ * Not thread-safe; the owner serializes access.
+ */
+class Lanes
+{
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  enum Lane {
+    Interactive, // Logins and anything a player is waiting on.
+    Results,     // Game results.
+    Telemetry,   // Audits.
+    Count
+  };
+
+  struct Message {
+    std::string reqid;
+    std::string path;
+    std::string payload;
+    bool binary;
+  };
+
+  Lanes();
+
+  /**
+   * @brief The lane for a request path.
+   */
+  static Lane classify(const char* path);
+  static const char* name(Lane lane);
+
+  /**
+   * @brief Takes a token to send a message directly. Only allowed while
+   *        the lane is empty, to keep its order.
+   */
+  bool take(Lane lane);
+
+  /**
+   * @brief Queues a message.
+   *
+   * @return False if the lane was full, in which case its oldest
+   *         message was moved to dropped.
+   */
+  bool push(Lane lane, Message&& msg, Message& dropped);
+
+  /**
+   * @brief Retrieves the next message that may be sent now, or nullptr.
+   *        It stays queued until pop().
+   */
+  const Message* next(Lane& lane);
+  void pop(Lane lane);
+
+  /**
+   * @brief Time until a queued message may be sent.
+   */
+  Clock::duration wait();
+
+  bool empty(Lane lane) const { return lanes[lane].queue.empty(); }
+  size_t size() const;
+
+private:
+  struct Bucket {
+    double rate;
+    double burst;
+    double tokens;
+    Clock::time_point last;
+
+    void refill(Clock::time_point now);
+  };
+
+  struct State {
+    std::deque<Message> queue;
+    size_t max;
+    Bucket bucket;
+    int weight;
+    int current = 0;
+  };
+
+  std::array<State, Count> lanes;
+};
+
+// vim: set ts=2 sw=2 expandtab:
@@ -0,0 +1,79 @@
+// Spooky Scoreboard Daemon
+// Copyright (C) 2025 Greg MacKenzie
+// https://spookyscoreboard.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "Leaderboard.h"
+
+using namespace std;
+
+bool Leaderboard::apply(const Json::Value& update)
+{
+  lock_guard<mutex> lock(mtx);
+
+  if (update.isMember("snapshot")) {
+    entries.clear();
+    for (const auto& entry : update["snapshot"]) upsert(entry);
+  }
+  else {
+    if (!synced || update["base"].asUInt64() != seq) return false;
+
+    for (const auto& name : update["remove"]) {
+      entries.erase(remove_if(entries.begin(), entries.end(), [&](const Entry& e) {
+        return e.name == name.asString();
+      }), entries.end());
+    }
+
+    for (const auto& entry : update["upsert"]) upsert(entry);
+  }
+
+  stable_sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+    return a.score > b.score;
+  });
+
+  if (entries.size() > LEADERBOARD_MAX) entries.resize(LEADERBOARD_MAX);
+
+  seq = update["seq"].asUInt64();
+  synced = true;
+  return true;
+}
+
+void Leaderboard::upsert(const Json::Value& entry)
+{
+  const string name = entry["name"].asString();
+  const Json::Value& s = entry["score"];
+  const uint64_t score = s.isString() ? strtoull(s.asCString(), nullptr, 10) : s.asUInt64();
+
+  auto it = find_if(entries.begin(), entries.end(), [&](const Entry& e) { return e.name == name; });
+  if (it != entries.end()) it->score = score;
+  else entries.push_back({name, score});
+}
+
+vector<Leaderboard::Entry> Leaderboard::top(size_t n)
+{
+  lock_guard<mutex> lock(mtx);
+  return vector<Entry>(entries.begin(), entries.begin() + static_cast<ptrdiff_t>(min(n, entries.size())));
+}
+
+bool Leaderboard::empty()
+{
+  lock_guard<mutex> lock(mtx);
+  return entries.empty();
+}
+
+// vim: set ts=2 sw=2 expandtab:
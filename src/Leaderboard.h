@@ -0,0 +1,71 @@
+// Spooky Scoreboard Daemon
+// Copyright (C) 2025 Greg MacKenzie
+// https://spookyscoreboard.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <json/json.h>
+
+// Entries kept; the server may send more.
+#define LEADERBOARD_MAX 100
+
+// Entries shown in the message window.
+#define LEADERBOARD_TOP 5
+
+/**
+ * A leaderboard pushed by the server, kept current by deltas.
+ *
+ * Snapshot: {"seq": N, "snapshot": [{"name": ..., "score": ...}, ...]}
+ * Delta:    {"seq": N, "base": N - 1, "upsert": [...], "remove": [names]}
+ */
+class Leaderboard
+{
+public:
+  struct Entry {
+    std::string name;
+    uint64_t score;
+  };
+
+  /**
+   * @brief Applies a snapshot or delta.
+   *
+   * @return False if a delta doesn't follow on from the table held,
+   *         in which case a snapshot is needed.
+   */
+  bool apply(const Json::Value& update);
+
+  /**
+   * @brief Retrieves up to n entries, best first.
+   */
+  std::vector<Entry> top(size_t n);
+
+  bool empty();
+
+private:
+  std::mutex mtx;
+  std::vector<Entry> entries;
+  uint64_t seq = 0;
+  bool synced = false;
+
+  void upsert(const Json::Value& entry);
+};
+
+// vim: set ts=2 sw=2 expandtab:
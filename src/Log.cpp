@@ -0,0 +1,260 @@
+// Spooky Scoreboard Daemon
+// Copyright (C) 2025 Greg MacKenzie
+// https://spookyscoreboard.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstring>
+#include <cstdlib>
+
+#include <unistd.h>
+
+#ifdef HAVE_SD_JOURNAL
+#include <systemd/sd-journal.h>
+#endif
+
+#include "Log.h"
+#include "RingBuffer.h"
+
+// Lines queued before the flusher falls behind and starts dropping.
+#define LOG_QUEUE_SIZE 512
+
+// Identical warnings/errors allowed per window before suppression.
+#define LOG_RATE_BURST 5
+#define LOG_RATE_WINDOW 60
+#define LOG_RATE_SLOTS 64
+
+using namespace std;
+
+namespace
+{
+  struct Entry {
+    Log::Level level;
+    size_t len;
+    char text[LOG_LINE_MAX];
+  };
+
+  struct RateSlot {
+    atomic<uint64_t> hash{0};
+    atomic<int64_t> windowStart{0};
+    atomic<uint32_t> count{0};
+    atomic<uint32_t> suppressed{0};
+  };
+
+  RingBuffer<Entry, LOG_QUEUE_SIZE> queue;
+  RateSlot rateSlots[LOG_RATE_SLOTS];
+
+  atomic<bool> running{false};
+  atomic<uint64_t> dropped{0};
+
+  thread flusher;
+  mutex flushMtx;
+  condition_variable flushCv;
+
+  // Lines carry sd-daemon "<N>" priority prefixes when stderr is the journal.
+  bool journalStream = false;
+
+  int64_t nowSecs()
+  {
+    return chrono::duration_cast<chrono::seconds>(
+      chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  uint64_t fnv1a(const char* s, size_t n)
+  {
+    uint64_t h = 14695981039346656037ull;
+    for (size_t i = 0; i < n; i++) {
+      h ^= static_cast<unsigned char>(s[i]);
+      h *= 1099511628211ull;
+    }
+    return h ? h : 1;
+  }
+
+  /**
+   * Best-effort per-message rate limit; races only let an extra line
+   * through. Returns false to suppress the line, or sets repeats to the
+   * number of lines suppressed since the last one let through.
+   */
+  bool rateLimit(const char* text, size_t len, uint32_t& repeats)
+  {
+    uint64_t h = fnv1a(text, len);
+    RateSlot& slot = rateSlots[h % LOG_RATE_SLOTS];
+    int64_t now = nowSecs();
+
+    repeats = 0;
+
+    if (slot.hash.load(memory_order_relaxed) != h) {
+      slot.hash.store(h, memory_order_relaxed);
+      slot.windowStart.store(now, memory_order_relaxed);
+      slot.count.store(1, memory_order_relaxed);
+      slot.suppressed.store(0, memory_order_relaxed);
+      return true;
+    }
+
+    if (now - slot.windowStart.load(memory_order_relaxed) >= LOG_RATE_WINDOW) {
+      slot.windowStart.store(now, memory_order_relaxed);
+      slot.count.store(1, memory_order_relaxed);
+      repeats = slot.suppressed.exchange(0, memory_order_relaxed);
+      return true;
+    }
+
+    if (slot.count.fetch_add(1, memory_order_relaxed) < LOG_RATE_BURST) return true;
+
+    slot.suppressed.fetch_add(1, memory_order_relaxed);
+    return false;
+  }
+
+  void writeAll(const char* data, size_t n)
+  {
+    while (n > 0) {
+      ssize_t w = write(STDERR_FILENO, data, n);
+      if (w <= 0) return;
+      data += w;
+      n -= static_cast<size_t>(w);
+    }
+  }
+
+  /**
+   * Appends one formatted line to an output batch.
+   */
+  void formatLine(string& out, Log::Level level, const char* text, size_t len)
+  {
+    if (journalStream) {
+      out += '<';
+      out += static_cast<char>('0' + static_cast<int>(level));
+      out += '>';
+    }
+    else if (level == Log::Level::Error) {
+      out += "Error: ";
+    }
+    else if (level == Log::Level::Warning) {
+      out += "Warning: ";
+    }
+
+    out.append(text, len);
+    out += '\n';
+  }
+
+  void emit(const Entry& e, string& batch)
+  {
+#ifdef HAVE_SD_JOURNAL
+    if (journalStream) {
+      sd_journal_print(static_cast<int>(e.level), "%.*s", static_cast<int>(e.len), e.text);
+      return;
+    }
+#endif
+    formatLine(batch, e.level, e.text, e.len);
+  }
+
+  /**
+   * Drains the queue, writing each batch with a single syscall.
+   */
+  void drain()
+  {
+    string batch;
+
+    while (queue.consume([&batch](Entry& e) { emit(e, batch); })) {}
+
+    uint64_t n = dropped.exchange(0, memory_order_relaxed);
+    if (n > 0) {
+      string msg = to_string(n) + " log lines dropped";
+      formatLine(batch, Log::Level::Warning, msg.data(), msg.size());
+    }
+
+    if (!batch.empty()) writeAll(batch.data(), batch.size());
+  }
+
+  void flushLoop()
+  {
+    while (running.load()) {
+      {
+        unique_lock<mutex> lock(flushMtx);
+        flushCv.wait_for(lock, chrono::milliseconds(250), []() {
+          return !running.load() || !queue.empty();
+        });
+      }
+      drain();
+    }
+    drain();
+  }
+}
+
+void Log::start()
+{
+  if (running.exchange(true)) return;
+  journalStream = getenv("JOURNAL_STREAM") != nullptr;
+  flusher = thread(flushLoop);
+}
+
+void Log::stop()
+{
+  if (!running.exchange(false)) return;
+  flushCv.notify_one();
+  if (flusher.joinable()) flusher.join();
+}
+
+Log::Line::~Line()
+{
+  uint32_t repeats = 0;
+
+  if (level <= Level::Warning && !rateLimit(buf, len, repeats)) return;
+
+  if (repeats > 0) {
+    string note = " (repeated " + to_string(repeats) + " more times)";
+    append(note.data(), note.size());
+  }
+
+  // Not started, or shutting down: write synchronously.
+  if (!running.load()) {
+    string out;
+    formatLine(out, level, buf, len);
+    writeAll(out.data(), out.size());
+    return;
+  }
+
+  bool queued = queue.produce([this](Entry& e) {
+    e.level = level;
+    e.len = len;
+    memcpy(e.text, buf, len);
+  });
+
+  if (!queued) {
+    dropped.fetch_add(1, memory_order_relaxed);
+    return;
+  }
+
+  // Waking the flusher takes no lock; a missed wakeup costs at most 250ms.
+  flushCv.notify_one();
+}
+
+Log::Line& Log::Line::append(const char* s)
+{
+  return append(s, strlen(s));
+}
+
+Log::Line& Log::Line::append(const char* s, size_t n)
+{
+  size_t room = LOG_LINE_MAX - len;
+  if (n > room) n = room;
+  memcpy(buf + len, s, n);
+  len += n;
+  return *this;
+}
+
+// vim: set ts=2 sw=2 expandtab:
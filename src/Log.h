@@ -0,0 +1,99 @@
+// Spooky Scoreboard Daemon
+// Copyright (C) 2025 Greg MacKenzie
+// https://spookyscoreboard.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <string>
+#include <cstdio>
+#include <type_traits>
+
+#define LOG_LINE_MAX 256
+
+// Log a line: LOG_INFO << "Uploading scores...";
+#define LOG_ERROR Log::Line(Log::Level::Error)
+#define LOG_WARNING Log::Line(Log::Level::Warning)
+#define LOG_INFO Log::Line(Log::Level::Info)
+
+// Debug lines are compiled out of release builds entirely.
+#ifdef DEBUG
+#define LOG_DEBUG Log::Line(Log::Level::Debug)
+#else
+#define LOG_DEBUG while (false) Log::Line(Log::Level::Debug)
+#endif
+
+namespace Log
+{
+  // Values match syslog priorities, as used by the journal.
+  enum class Level { Error = 3, Warning = 4, Info = 6, Debug = 7 };
+
+  /**
+   * @brief Starts the background flusher.
+   *
+   * Until started, and after stop(), lines are written synchronously.
+   */
+  void start();
+
+  /**
+   * @brief Flushes pending lines and stops the background flusher.
+   */
+  void stop();
+
+  /**
+   * A single log line, formatted on the caller's stack and queued
+   * without blocking when it goes out of scope.
+   */
+  class Line
+  {
+  public:
+    explicit Line(Level lvl) : level(lvl) {}
+    ~Line();
+
+    Line(const Line&) = delete;
+    Line& operator=(const Line&) = delete;
+
+    Line& operator<<(const char* s) { return append(s ? s : "(null)"); }
+    Line& operator<<(const std::string& s) { return append(s.data(), s.size()); }
+    Line& operator<<(char c) { return append(&c, 1); }
+    Line& operator<<(bool b) { return append(b ? "true" : "false"); }
+    Line& operator<<(double d) { return format("%g", d); }
+
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value, Line&>::type operator<<(T v)
+    {
+      if (std::is_signed<T>::value) return format("%lld", static_cast<long long>(v));
+      return format("%llu", static_cast<unsigned long long>(v));
+    }
+
+  private:
+    Level level;
+    size_t len = 0;
+    char buf[LOG_LINE_MAX];
+
+    Line& append(const char* s);
+    Line& append(const char* s, size_t n);
+
+    template <typename T>
+    Line& format(const char* fmt, T v)
+    {
+      char tmp[32];
+      int n = snprintf(tmp, sizeof(tmp), fmt, v);
+      return n > 0 ? append(tmp, static_cast<size_t>(n)) : *this;
+    }
+  };
+}
+
+// vim: set ts=2 sw=2 expandtab:
@@ -0,0 +1,109 @@
+// Spooky Scoreboard Daemon
+// Copyright (C) 2025 Greg MacKenzie
+// https://spookyscoreboard.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "GameBase.h"
+#include "Config.h"
+#include "Leaderboard.h"
+#include "MessageQueue.h"
+
+class WebSocket;
+class Player;
+class QrCode;
+class AuditCollector;
+class ScoreHistory;
+
+struct players {
+  uint8_t numPlayers{0};
+  std::array<std::string, 4> player{};
+  std::array<std::string, 4> uuid{};
+
+  // Each player's best score on this machine, 0 if none.
+  std::array<uint64_t, 4> best{};
+
+  // Held while changing the list; logins and logouts happen on the
+  // executor, game ends on the watcher thread.
+  mutable std::mutex mtx;
+
+  void reset() {
+    std::lock_guard<std::mutex> lock(mtx);
+    numPlayers = 0;
+    std::fill(player.begin(), player.end(), "");
+    std::fill(uuid.begin(), uuid.end(), "");
+    best.fill(0);
+  }
+
+  uint8_t count() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return numPlayers;
+  }
+
+  std::array<std::string, 4> uuids() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return uuid;
+  }
+};
+
+/**
+ * Everything that belongs to one cabinet: its game, identity, server
+ * connection and who is playing. The daemon runs a single machine;
+ * ssbd-fleet runs many in one process.
+ */
+struct Machine {
+  explicit Machine(std::unique_ptr<GameBase> g);
+  ~Machine();
+
+  Machine(const Machine&) = delete;
+  Machine& operator=(const Machine&) = delete;
+
+  std::unique_ptr<GameBase> game;
+  Config config;
+
+  std::shared_ptr<WebSocket> webSocket;
+  std::shared_ptr<Player> playerHandler;
+  std::unique_ptr<QrCode> qrCode;
+  std::unique_ptr<AuditCollector> auditCollector;
+  std::unique_ptr<ScoreHistory> history;
+
+  players playerList;
+
+  // Server messages, drained by the message window.
+  MessageQueue messages;
+
+  // Shown in the message window when there's no message.
+  Leaderboard leaderboard;
+
+  /**
+   * @brief Shows a panel: 0-3 for players, 4 for server messages.
+   *
+   * The daemon draws panels with X11; headless machines leave this unset.
+   */
+  std::function<void(int)> showWindow;
+
+  void show(int index) const { if (showWindow) showWindow(index); }
+};
+
+// vim: set ts=2 sw=2 expandtab:
@@ -0,0 +1,201 @@
+// Spooky Scoreboard Daemon
+// Copyright (C) 2025 Greg MacKenzie
+// https://spookyscoreboard.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <algorithm>
+
+#include "MessageQueue.h"
+#include "Log.h"
+
+using namespace std;
+
+bool MessageQueue::push(const Json::Value& payload)
+{
+  const auto now = Clock::now();
+
+  Message msg;
+  msg.id = payload["id"].asString();
+  msg.text = payload["message"].asString();
+  msg.priority = payload["priority"].asInt();
+  msg.duration = clamp(payload.get("duration", MESSAGE_DURATION).asInt(), 1, MESSAGE_DURATION_MAX);
+
+  const int64_t ttl = clamp<int64_t>(payload.get("ttl", MESSAGE_TTL).asInt64(), 0, MESSAGE_TTL_MAX);
+
+  // The ttl runs from the requested start, even one already past.
+  // Bounded before the conversion so server values can't overflow it.
+  int64_t delay = 0;
+  if (payload.isMember("at")) {
+    const int64_t epoch = chrono::duration_cast<chrono::seconds>(chrono::system_clock::now().time_since_epoch()).count();
+    delay = clamp<int64_t>(payload["at"].asInt64(), epoch - ttl - 1, epoch + MESSAGE_DELAY_MAX) - epoch;
+  }
+  else {
+    delay = clamp<int64_t>(payload["delay"].asInt64(), 0, MESSAGE_DELAY_MAX);
+  }
+
+  const auto requested = now + chrono::seconds(delay);
+  msg.start = max(requested, now);
+  msg.expires = requested + chrono::seconds(ttl);
+  if (msg.expires <= now) {
+    LOG_DEBUG << "Message expired before it arrived.";
+    return false;
+  }
+
+  lock_guard<mutex> lock(mtx);
+  purge(now);
+
+  // A revised message replaces the original, even mid-display.
+  if (!msg.id.empty() && isShowing && showing.id == msg.id) {
+    showing.text = msg.text;
+    return false;
+  }
+
+  if (isShowing && showing.text == msg.text) {
+    LOG_DEBUG << "Message already showing.";
+    return false;
+  }
+
+  // Revisions first, so an older copy of the text can't absorb one.
+  for (auto& m : queue) {
+    if (!msg.id.empty() && m.id == msg.id) {
+      msg.order = m.order;
+      m = msg;
+      return true;
+    }
+  }
+
+  for (auto& m : queue) {
+    if (m.text == msg.text) {
+      merge(m, msg);
+      LOG_DEBUG << "Message merged with one queued.";
+      return false;
+    }
+  }
+
+  msg.order = counter++;
+
+  if (queue.size() >= MESSAGE_QUEUE_MAX) {
+    auto last = max_element(queue.begin(), queue.end(), before);
+    if (before(*last, msg)) {
+      LOG_WARNING << "Message queue full, dropping message.";
+      return false;
+    }
+
+    LOG_WARNING << "Message queue full, dropping queued message.";
+    queue.erase(last);
+  }
+
+  queue.push_back(move(msg));
+  return true;
+}
+
+bool MessageQueue::next(Message& msg)
+{
+  const auto now = Clock::now();
+
+  lock_guard<mutex> lock(mtx);
+  purge(now);
+
+  auto it = best(now);
+  if (it == queue.end()) {
+    isShowing = false;
+    showing = Message();
+    return false;
+  }
+
+  showing = move(*it);
+  isShowing = true;
+  queue.erase(it);
+
+  msg = showing;
+  return true;
+}
+
+bool MessageQueue::ready()
+{
+  const auto now = Clock::now();
+
+  lock_guard<mutex> lock(mtx);
+  purge(now);
+  return best(now) != queue.end();
+}
+
+bool MessageQueue::scheduled(Clock::time_point& when)
+{
+  const auto now = Clock::now();
+  bool found = false;
+
+  lock_guard<mutex> lock(mtx);
+  for (const auto& m : queue) {
+    if (m.start > now && (!found || m.start < when)) {
+      when = m.start;
+      found = true;
+    }
+  }
+
+  return found;
+}
+
+string MessageQueue::current()
+{
+  lock_guard<mutex> lock(mtx);
+  return isShowing ? showing.text : string();
+}
+
+void MessageQueue::purge(Clock::time_point now)
+{
+  queue.erase(remove_if(queue.begin(), queue.end(), [&](const Message& m) {
+    return m.expires < now;
+  }), queue.end());
+}
+
+/**
+ * The due message to show first, or end().
+ */
+vector<MessageQueue::Message>::iterator MessageQueue::best(Clock::time_point now)
+{
+  auto pick = queue.end();
+
+  for (auto it = queue.begin(); it != queue.end(); ++it) {
+    if (it->start > now) continue;
+    if (pick == queue.end() || before(*it, *pick)) pick = it;
+  }
+
+  return pick;
+}
+
+/**
+ * Whether a is shown before b.
+ */
+bool MessageQueue::before(const Message& a, const Message& b)
+{
+  if (a.priority != b.priority) return a.priority > b.priority;
+  if (a.start != b.start) return a.start < b.start;
+  return a.order < b.order;
+}
+
+/**
+ * Folds a duplicate into a queued message: the more urgent and longer
+ * lasting of the two.
+ */
+void MessageQueue::merge(Message& into, const Message& msg)
+{
+  into.priority = max(into.priority, msg.priority);
+  into.duration = max(into.duration, msg.duration);
+  into.start = min(into.start, msg.start);
+  into.expires = max(into.expires, msg.expires);
+}
+
+// vim: set ts=2 sw=2 expandtab:
@@ -0,0 +1,114 @@
+// Spooky Scoreboard Daemon
+// Copyright (C) 2025 Greg MacKenzie
+// https://spookyscoreboard.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <json/json.h>
+
+// Messages waiting to be shown; when full, the one that would be shown
+// last is dropped.
+#define MESSAGE_QUEUE_MAX 16
+
+// Seconds a message is shown, by default and at most.
+#define MESSAGE_DURATION 15
+#define MESSAGE_DURATION_MAX 300
+
+// Seconds a message may wait past its start before it's stale, by
+// default and at most.
+#define MESSAGE_TTL 300
+#define MESSAGE_TTL_MAX 86400
+
+// Seconds ahead a message may be scheduled.
+#define MESSAGE_DELAY_MAX 86400
+
+/**
+ * Server messages waiting for the message window, shown one at a time.
+ *
+ * {"message": TEXT, "id": ..., "priority": N, "duration": SECS,
+ *  "ttl": SECS, "at": UNIX_TIME | "delay": SECS}
+ *
+ * All but the text are optional. The ttl counts from the requested
+ * start, so a message that arrives late has less time left. Higher
+ * priority goes first, then the earliest start. A message with the id
+ * of one queued or showing replaces it; one with the same text as one
+ * queued or showing is merged into it. Empty text shows the
+ * leaderboard.
+ */
+class MessageQueue
+{
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  struct Message {
+    std::string id;
+    std::string text;
+    int priority = 0;
+    int duration = MESSAGE_DURATION;
+    Clock::time_point start;
+    Clock::time_point expires;
+    uint64_t order = 0;
+  };
+
+  /**
+   * @brief Queues a message from a server command.
+   *
+   * @return False if it was dropped or merged into another.
+   */
+  bool push(const Json::Value& msg);
+
+  /**
+   * @brief Makes the next due message the one showing.
+   *
+   * @return False, clearing the one showing, if none is due.
+   */
+  bool next(Message& msg);
+
+  /**
+   * @brief Whether a message is due to be shown.
+   */
+  bool ready();
+
+  /**
+   * @brief Retrieves the earliest start of a message not yet due.
+   */
+  bool scheduled(Clock::time_point& when);
+
+  /**
+   * @brief Retrieves the text showing, or an empty string.
+   */
+  std::string current();
+
+private:
+  std::mutex mtx;
+  std::vector<Message> queue;
+  Message showing;
+  bool isShowing = false;
+  uint64_t counter = 0;
+
+  void purge(Clock::time_point now);
+  std::vector<Message>::iterator best(Clock::time_point now);
+  static bool before(const Message& a, const Message& b);
+  static void merge(Message& into, const Message& msg);
+};
+
+// vim: set ts=2 sw=2 expandtab:
@@ -0,0 +1,373 @@
+// Spooky Scoreboard Daemon
+// Copyright (C) 2025 Greg MacKenzie
+// https://spookyscoreboard.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "Metrics.h"
+#include "Log.h"
+
+using namespace std;
+
+namespace
+{
+  enum class Type { Counter, Gauge, Histogram };
+
+  struct Family {
+    Type type;
+    string help;
+    map<string, unique_ptr<Metrics::Counter>> counters;
+    map<string, unique_ptr<Metrics::Gauge>> gauges;
+    map<string, unique_ptr<Metrics::Histogram>> histograms;
+  };
+
+  struct Registry {
+    mutex mtx;
+    map<string, Family> families;
+  };
+
+  /**
+   * Metrics are registered from static initializers in other files, and
+   * may be touched by threads still running at exit, so the registry is
+   * created on first use and never destroyed.
+   */
+  Registry& registry()
+  {
+    static Registry* r = new Registry();
+    return *r;
+  }
+
+  thread exporterThread;
+  string exporterPath;
+  int listenFds[2] = {-1, -1};
+  int wakePipe[2] = {-1, -1};
+
+  /**
+   * Renders labels as {k="v",...}, the form used as the series key.
+   */
+  string labelString(const Metrics::Labels& labels)
+  {
+    if (labels.empty()) return "";
+
+    string out = "{";
+    for (const auto& kv : labels) {
+      if (out.size() > 1) out += ',';
+      out += kv.first + "=\"";
+      for (char c : kv.second) {
+        if (c == '"' || c == '\\') out += '\\';
+        if (c == '\n') { out += "\\n"; continue; }
+        out += c;
+      }
+      out += '"';
+    }
+
+    return out + "}";
+  }
+
+  Family& family(const string& name, const string& help, Type type)
+  {
+    auto& families = registry().families;
+    auto it = families.find(name);
+    if (it == families.end()) {
+      it = families.emplace(name, Family()).first;
+      it->second.type = type;
+      it->second.help = help;
+    }
+    return it->second;
+  }
+
+  template <typename T>
+  T& lookup(map<string, unique_ptr<T>>& metrics, const string& labels)
+  {
+    auto& m = metrics[labels];
+    if (!m) m.reset(new T());
+    return *m;
+  }
+
+  string formatDouble(double d)
+  {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.9g", d);
+    return buf;
+  }
+
+  /**
+   * Answers one scrape: waits briefly for the request, then responds
+   * with the current metrics regardless of what was asked.
+   */
+  void serve(int fd)
+  {
+    char buf[1024];
+    string req;
+
+    struct pollfd pfd = {fd, POLLIN, 0};
+    while (req.find("\r\n\r\n") == string::npos && poll(&pfd, 1, 1000) > 0) {
+      ssize_t n = read(fd, buf, sizeof(buf));
+      if (n <= 0) break;
+      req.append(buf, static_cast<size_t>(n));
+      if (req.size() > 8192) break;
+    }
+
+    string body = Metrics::render();
+    string resp =
+      "HTTP/1.0 200 OK\r\n"
+      "Content-Type: text/plain; version=0.0.4\r\n"
+      "Content-Length: " + to_string(body.size()) + "\r\n"
+      "Connection: close\r\n\r\n" + body;
+
+    size_t off = 0;
+    while (off < resp.size()) {
+      ssize_t n = write(fd, resp.data() + off, resp.size() - off);
+      if (n <= 0) break;
+      off += static_cast<size_t>(n);
+    }
+  }
+
+  void exportLoop()
+  {
+    while (true) {
+      struct pollfd fds[3];
+      nfds_t nfds = 0;
+
+      fds[nfds++] = {wakePipe[0], POLLIN, 0};
+      for (int fd : listenFds) {
+        if (fd >= 0) fds[nfds++] = {fd, POLLIN, 0};
+      }
+
+      if (poll(fds, nfds, -1) < 0) {
+        if (errno == EINTR) continue;
+        break;
+      }
+
+      // Break loop if wakePipe[1] is written to.
+      if (fds[0].revents & POLLIN) break;
+
+      for (nfds_t i = 1; i < nfds; i++) {
+        if (!(fds[i].revents & POLLIN)) continue;
+
+        int client = accept4(fds[i].fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client < 0) continue;
+        serve(client);
+        close(client);
+      }
+    }
+  }
+
+  int listenUnix(const string& path)
+  {
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+    unlink(path.c_str());
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 4) < 0) {
+      close(fd);
+      return -1;
+    }
+
+    return fd;
+  }
+
+  int listenTcp(int port)
+  {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 4) < 0) {
+      close(fd);
+      return -1;
+    }
+
+    return fd;
+  }
+}
+
+void Metrics::Histogram::observe(uint64_t ns)
+{
+  int i = 0;
+
+  // Values equal to a bound belong to that bucket, hence ns - 1.
+  uint64_t v = ns > 0 ? ns - 1 : 0;
+  if (v >= (1ull << MinExp)) {
+    int e = 63 - __builtin_clzll(v);
+    int half = static_cast<int>((v >> (e - 1)) & 1);
+    i = 1 + (e - MinExp) * 2 + half;
+    if (i > Buckets - 1) i = Buckets - 1;
+  }
+
+  counts[i].fetch_add(1, memory_order_relaxed);
+  sum.fetch_add(ns, memory_order_relaxed);
+  n.fetch_add(1, memory_order_relaxed);
+}
+
+void Metrics::Histogram::observe(Clock::duration d)
+{
+  auto ns = chrono::duration_cast<chrono::nanoseconds>(d).count();
+  observe(static_cast<uint64_t>(ns > 0 ? ns : 0));
+}
+
+double Metrics::Histogram::upperBound(int i)
+{
+  if (i >= Buckets - 1) return INFINITY;
+  if (i == 0) return ldexp(1.0, MinExp) / 1e9;
+
+  int e = MinExp + (i - 1) / 2;
+  double bound = (i - 1) % 2 == 0 ? 1.5 * ldexp(1.0, e) : ldexp(1.0, e + 1);
+  return bound / 1e9;
+}
+
+Metrics::Counter& Metrics::counter(const string& name, const string& help, const Labels& labels)
+{
+  lock_guard<mutex> lock(registry().mtx);
+  return lookup(family(name, help, Type::Counter).counters, labelString(labels));
+}
+
+Metrics::Gauge& Metrics::gauge(const string& name, const string& help, const Labels& labels)
+{
+  lock_guard<mutex> lock(registry().mtx);
+  return lookup(family(name, help, Type::Gauge).gauges, labelString(labels));
+}
+
+Metrics::Histogram& Metrics::histogram(const string& name, const string& help, const Labels& labels)
+{
+  lock_guard<mutex> lock(registry().mtx);
+  return lookup(family(name, help, Type::Histogram).histograms, labelString(labels));
+}
+
+string Metrics::render()
+{
+  lock_guard<mutex> lock(registry().mtx);
+  string out;
+
+  for (const auto& entry : registry().families) {
+    const string& name = entry.first;
+    const Family& f = entry.second;
+
+    out += "# HELP " + name + " " + f.help + "\n";
+
+    switch (f.type) {
+    case Type::Counter:
+      out += "# TYPE " + name + " counter\n";
+      for (const auto& m : f.counters) {
+        out += name + m.first + " " + to_string(m.second->value()) + "\n";
+      }
+      break;
+
+    case Type::Gauge:
+      out += "# TYPE " + name + " gauge\n";
+      for (const auto& m : f.gauges) {
+        out += name + m.first + " " + to_string(m.second->value()) + "\n";
+      }
+      break;
+
+    case Type::Histogram:
+      out += "# TYPE " + name + " histogram\n";
+      for (const auto& m : f.histograms) {
+        // Labels were rendered as {..}; strip the braces to add "le".
+        string base = m.first.empty() ? "" : m.first.substr(1, m.first.size() - 2);
+        if (!base.empty()) base += ',';
+
+        uint64_t cumulative = 0;
+        for (int i = 0; i < Histogram::Buckets; i++) {
+          cumulative += m.second->bucket(i);
+          double ub = Histogram::upperBound(i);
+          string le = std::isinf(ub) ? "+Inf" : formatDouble(ub);
+          out += name + "_bucket{" + base + "le=\"" + le + "\"} " + to_string(cumulative) + "\n";
+        }
+
+        out += name + "_sum" + m.first + " " + formatDouble(static_cast<double>(m.second->sumNs()) / 1e9) + "\n";
+        out += name + "_count" + m.first + " " + to_string(m.second->count()) + "\n";
+      }
+      break;
+    }
+  }
+
+  return out;
+}
+
+void Metrics::startExporter(const string& socketPath, int port)
+{
+  if (exporterThread.joinable()) return;
+
+  if (pipe2(wakePipe, O_CLOEXEC) == -1) {
+    LOG_ERROR << "Failed to create metrics wake pipe.";
+    return;
+  }
+
+  listenFds[0] = listenUnix(socketPath);
+  if (listenFds[0] < 0) {
+    LOG_ERROR << "Failed to listen on " << socketPath;
+  }
+  else {
+    exporterPath = socketPath;
+  }
+
+  if (port > 0) {
+    listenFds[1] = listenTcp(port);
+    if (listenFds[1] < 0) LOG_ERROR << "Failed to listen on 127.0.0.1:" << port;
+  }
+
+  exporterThread = thread(exportLoop);
+}
+
+void Metrics::stopExporter()
+{
+  if (!exporterThread.joinable()) return;
+
+  if (write(wakePipe[1], "", 1) < 0) {}
+  exporterThread.join();
+
+  for (int& fd : listenFds) {
+    if (fd >= 0) close(fd);
+    fd = -1;
+  }
+
+  for (int& fd : wakePipe) {
+    close(fd);
+    fd = -1;
+  }
+
+  if (!exporterPath.empty()) unlink(exporterPath.c_str());
+  exporterPath.clear();
+}
+
+// vim: set ts=2 sw=2 expandtab:
@@ -0,0 +1,124 @@
+// Spooky Scoreboard Daemon
+// Copyright (C) 2025 Greg MacKenzie
+// https://spookyscoreboard.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace Metrics
+{
+  using Labels = std::map<std::string, std::string>;
+  using Clock = std::chrono::steady_clock;
+
+  class Counter
+  {
+  public:
+    void inc(uint64_t n = 1) { v.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t value() const { return v.load(std::memory_order_relaxed); }
+
+  private:
+    std::atomic<uint64_t> v{0};
+  };
+
+  class Gauge
+  {
+  public:
+    void set(int64_t n) { v.store(n, std::memory_order_relaxed); }
+    void add(int64_t n = 1) { v.fetch_add(n, std::memory_order_relaxed); }
+    void sub(int64_t n = 1) { v.fetch_sub(n, std::memory_order_relaxed); }
+    int64_t value() const { return v.load(std::memory_order_relaxed); }
+
+  private:
+    std::atomic<int64_t> v{0};
+  };
+
+  /**
+   * Latency histogram with log-linear buckets, two per power of two,
+   * from about 1us to 137s. Recording is a handful of relaxed atomics.
+   */
+  class Histogram
+  {
+  public:
+    static constexpr int MinExp = 10;
+    static constexpr int MaxExp = 37;
+    static constexpr int Buckets = (MaxExp - MinExp) * 2 + 2;
+
+    void observe(uint64_t ns);
+    void observe(Clock::duration d);
+
+    /**
+     * @brief Upper bound of a bucket in seconds; the last is +Inf.
+     */
+    static double upperBound(int i);
+
+    uint64_t bucket(int i) const { return counts[i].load(std::memory_order_relaxed); }
+    uint64_t count() const { return n.load(std::memory_order_relaxed); }
+    uint64_t sumNs() const { return sum.load(std::memory_order_relaxed); }
+
+  private:
+    std::atomic<uint64_t> counts[Buckets] = {};
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> n{0};
+  };
+
+  /**
+   * Records the time from construction to destruction.
+   */
+  class Timer
+  {
+  public:
+    explicit Timer(Histogram& hist) : h(hist), start(Clock::now()) {}
+    ~Timer() { h.observe(Clock::now() - start); }
+
+  private:
+    Histogram& h;
+    Clock::time_point start;
+  };
+
+  /**
+   * @brief Looks up or registers a metric.
+   *
+   * Registration takes a lock; hot paths should keep the returned
+   * reference, which stays valid for the life of the process.
+   */
+  Counter& counter(const std::string& name, const std::string& help, const Labels& labels = {});
+  Gauge& gauge(const std::string& name, const std::string& help, const Labels& labels = {});
+  Histogram& histogram(const std::string& name, const std::string& help, const Labels& labels = {});
+
+  /**
+   * @brief Renders every metric in Prometheus text format.
+   */
+  std::string render();
+
+  /**
+   * @brief Serves metrics on a UNIX socket and optionally a localhost port.
+   *
+   * Both speak just enough HTTP for Prometheus or
+   * curl --unix-socket to scrape them.
+   *
+   * @param socketPath Path of the UNIX socket to create.
+   * @param port TCP port on 127.0.0.1, or 0 to disable.
+   */
+  void startExporter(const std::string& socketPath, int port = 0);
+  void stopExporter();
+}
+
+// vim: set ts=2 sw=2 expandtab:
@@ -15,82 +15,107 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
-#include <iostream>
 #include <uuid/uuid.h>
 
 #include "main.h"
-#include "x11.h"
 #include "Player.h"
+#include "WebSocket.h"
+#include "ScoreHistory.h"
+#include "Log.h"
+#include "Metrics.h"
 
 using namespace std;
 
 void Player::login(const vector<char>& uuid, int position)
 {
   if (uuid.size() != MAX_UUID_LEN) {
-    cerr << "Invalid UUID packet size: " << uuid.size() << endl;
+    LOG_ERROR << "Invalid UUID packet size: " << uuid.size();
     return;
   }
 
   uuid_t uuid_parsed;
   string uuid_str(uuid.begin(), uuid.begin() + MAX_UUID_LEN);
   if (uuid_parse(uuid_str.c_str(), uuid_parsed) != 0) {
-    cerr << "Invalid UUID format: " << uuid_str << endl;
+    LOG_ERROR << "Invalid UUID format: " << uuid_str;
     return;
   }
 
   if (position < 1 || position > 4) {
-    cerr << "Invalid player position: " << position << endl;
+    LOG_ERROR << "Invalid player position: " << position;
     return;
   }
 
+  players& playerList = machine.playerList;
+  bool occupied;
+  {
+    lock_guard<mutex> lock(playerList.mtx);
+    occupied = !playerList.player[position - 1].empty();
+  }
+
   // Show player window if position is already occupied.
-  if (!playerList.player[position - 1].empty()) {
-    startWindowThread(position - 1);
+  if (occupied) {
+    machine.show(position - 1);
     return;
   }
 
   // All spots are occupied.
-  if (playerList.numPlayers == 4) {
-    cerr << "All player spots are occupied." << endl;
+  if (playerList.count() == 4) {
+    LOG_ERROR << "All player spots are occupied.";
     return;
   }
 
-  Json::Value req;
-  req["path"] = "/api/v1/login";
-  req["method"] = "POST";
-  req["body"].append(uuid_str);
-  req["body"].append(position);
+  Json::Value body;
+  body.append(uuid_str);
+  body.append(position);
+
+  const auto scanned = Metrics::Clock::now();
 
-  webSocket->send(req, [this, position](const Json::Value& response) {
-    if (response["status"].asInt() != 200) {
-      cerr << "Failed to login player " << position << endl;
-      cerr << "Server returned code " << response["status"].asInt() << endl;
+  machine.webSocket->send({"/api/v1/login", "POST", &body}, [this, position, scanned, uuid_str](const WebSocket::Response& response) {
+    if (response.status != 200) {
+      LOG_ERROR << "Failed to login player " << position;
+      LOG_ERROR << "Server returned code " << response.status;
       return;
     }
 
     Json::Value user_data;
-    Json::Reader().parse(response["body"].asString(), user_data);
+    Json::Reader().parse(response.body, user_data);
 
     if (!user_data.isMember("message") ||
         !user_data["message"].isMember("username") ||
         !user_data["message"]["username"].isString()) {
 
-      cerr << "Invalid login response data for player " << position << endl;
+      LOG_ERROR << "Invalid login response data for player " << position;
       return;
     }
 
-    cout << "Player " << position << " logging in" << endl;
-    playerList.player[position - 1] = user_data["message"]["username"].asString();
-    ++playerList.numPlayers;
-    startWindowThread(position - 1);
+    LOG_INFO << "Player " << position << " logging in";
+    const uint64_t best = machine.history ? machine.history->personalBest(uuid_str).score : 0;
+    {
+      players& list = machine.playerList;
+      lock_guard<mutex> lock(list.mtx);
+      list.player[position - 1] = user_data["message"]["username"].asString();
+      list.uuid[position - 1] = uuid_str;
+      list.best[position - 1] = best;
+      ++list.numPlayers;
+    }
+    machine.show(position - 1);
+
+    static Metrics::Histogram& loginLatency = Metrics::histogram(
+      "ssbd_login_seconds", "Time from QR scan to a successful login response.");
+    loginLatency.observe(Metrics::Clock::now() - scanned);
   });
 }
 
 void Player::logout(int position)
 {
+  players& playerList = machine.playerList;
+  lock_guard<mutex> lock(playerList.mtx);
+
   if (!playerList.player[position - 1].empty()) {
-    cout << "Player " << position << " logging out." << endl;
+    LOG_INFO << "Player " << position << " logging out.";
     playerList.player[position - 1] = "";
+    playerList.uuid[position - 1] = "";
+    playerList.best[position - 1] = 0;
     --playerList.numPlayers;
   }
 }
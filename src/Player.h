@@ -17,17 +17,19 @@
 
 #pragma once
 
-#include "WebSocket.h"
+#include <vector>
+
+struct Machine;
 
 class Player {
 public:
-  Player(const std::shared_ptr<WebSocket>& ws) : webSocket(ws) {};
+  Player(Machine& m) : machine(m) {};
 
   void login(const std::vector<char>& uuid, int position);
   void logout(int position);
 
 private:
-  std::shared_ptr<WebSocket> webSocket;
+  Machine& machine;
 };
 
 // vim: set ts=2 sw=2 expandtab:
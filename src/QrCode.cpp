@@ -15,45 +15,35 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
-#include <iostream>
-#include <fstream>
+#include <sstream>
 #include <string>
-#include <sys/stat.h>
+#include <unordered_map>
+#include <cstdio>
+#include <cstdlib>
+#include <strings.h>
 
 #include "main.h"
 #include "QrCode.h"
+#include "Log.h"
 
 using namespace std;
 
-QrCode::QrCode(const shared_ptr<WebSocket>& ws) :
-  webSocket(ws),
-  qrCodePath(game->getTmpPath() + "/qrcode.xpm") {}
-
-QrCode::~QrCode()
-{
-  struct stat buf;
-  if (stat(qrCodePath.c_str(), &buf) == 0 && remove(qrCodePath.c_str()) != 0) {
-    cerr << "Failed to delete " << qrCodePath << endl;
-  }
-}
+QrCode::QrCode(const shared_ptr<WebSocket>& ws) : webSocket(ws) {}
 
 future<void> QrCode::download()
 {
   auto promise = make_shared<std::promise<void>>();
   auto future = promise->get_future();
 
-  Json::Value req;
-  req["path"] = "/api/v1/qr";
-  req["method"] = "POST"; // todo: should use GET perhaps(?)
-
-  webSocket->send(req, [this, promise](const Json::Value& response) {
-    if (response["status"].asInt() == 200) {
+  // todo: should use GET perhaps(?)
+  webSocket->send({"/api/v1/qr", "POST"}, [this, promise](const WebSocket::Response& response) {
+    if (response.status == 200) {
       try {
-        this->write(response["body"].asString());
+        this->parse(response.body);
         promise->set_value();
       }
       catch (const runtime_error& e) {
-        cerr << "Failed to request QR code." << endl;
+        LOG_ERROR << "Failed to decode QR code.";
         promise->set_exception(make_exception_ptr(e));
       }
     }
@@ -62,17 +52,110 @@ future<void> QrCode::download()
   return future;
 }
 
-void QrCode::write(const string& data)
+/**
+ * Whether an XPM color value is closer to black than white.
+ */
+static bool isDarkColor(const string& color)
 {
-  ofstream xpm(qrCodePath);
+  if (color.size() > 1 && color[0] == '#') {
+    size_t digits = (color.size() - 1) / 3;
+    if (digits == 0 || digits * 3 + 1 != color.size()) return false;
 
-  if (!xpm.is_open()) {
-    throw runtime_error("Unable to write QR code.");
+    // Use the two most significant hex digits of each component.
+    auto component = [&](size_t n) -> unsigned long {
+      string hex = color.substr(1 + n * digits, digits < 2 ? 1 : 2);
+      unsigned long v = strtoul(hex.c_str(), nullptr, 16);
+      return digits < 2 ? v * 17 : v;
+    };
+
+    unsigned long luma = (component(0) * 299 + component(1) * 587 + component(2) * 114) / 1000;
+    return luma < 128;
   }
- 
-  xpm << data;
-  xpm.close(); 
+
+  return strcasecmp(color.c_str(), "black") == 0;
 }
 
-// vim: set ts=2 sw=2 expandtab:
+void QrCode::parse(const string& data)
+{
+  // An XPM is a C array of strings; only the quoted parts matter.
+  vector<string> rows;
+  size_t pos = 0;
+
+  while ((pos = data.find('"', pos)) != string::npos) {
+    size_t end = data.find('"', pos + 1);
+    if (end == string::npos) break;
+    rows.emplace_back(data, pos + 1, end - pos - 1);
+    pos = end + 1;
+  }
+
+  unsigned int w = 0, h = 0, ncolors = 0, cpp = 0;
+  if (rows.empty() ||
+      sscanf(rows[0].c_str(), "%u %u %u %u", &w, &h, &ncolors, &cpp) != 4 ||
+      w == 0 || h == 0 || cpp == 0 || rows.size() < 1 + ncolors + h) {
+
+    throw runtime_error("Invalid QR code.");
+  }
+
+  // Color table: pixel key followed by context/color pairs.
+  unordered_map<string, bool> dark;
+  for (unsigned int i = 1; i <= ncolors; i++) {
+    const string& row = rows[i];
+    if (row.size() < cpp) throw runtime_error("Invalid QR code color.");
+
+    istringstream spec(row.substr(cpp));
+    string key, value, color;
+    while (spec >> key >> value) {
+      if (color.empty() || key == "c") color = value;
+    }
+
+    dark[row.substr(0, cpp)] = isDarkColor(color);
+  }
+
+  vector<uint8_t> packed((static_cast<size_t>(w) * h + 7) / 8, 0);
+  string px(cpp, ' ');
 
+  for (unsigned int y = 0; y < h; y++) {
+    const string& row = rows[1 + ncolors + y];
+    if (row.size() < static_cast<size_t>(w) * cpp) throw runtime_error("Invalid QR code row.");
+
+    for (unsigned int x = 0; x < w; x++) {
+      px.assign(row, static_cast<size_t>(x) * cpp, cpp);
+      auto it = dark.find(px);
+      if (it != dark.end() && it->second) {
+        size_t i = static_cast<size_t>(y) * w + x;
+        packed[i >> 3] |= static_cast<uint8_t>(1u << (i & 7));
+      }
+    }
+  }
+
+  width = w;
+  height = h;
+  bits = move(packed);
+}
+
+vector<char> QrCode::getBitmap(unsigned int size) const
+{
+  if (bits.empty() || size == 0) return {};
+
+  size_t stride = (size + 7) / 8;
+  vector<char> xbm(stride * size, 0);
+
+  // Integer nearest-neighbour: precompute the source column of each pixel.
+  vector<unsigned int> src_x(size);
+  for (unsigned int x = 0; x < size; x++) {
+    src_x[x] = static_cast<unsigned int>(static_cast<uint64_t>(x) * width / size);
+  }
+
+  for (unsigned int y = 0; y < size; y++) {
+    unsigned int sy = static_cast<unsigned int>(static_cast<uint64_t>(y) * height / size);
+    char* row = &xbm[y * stride];
+
+    for (unsigned int x = 0; x < size; x++) {
+      if (isDark(src_x[x], sy)) row[x >> 3] = static_cast<char>(row[x >> 3] | (1 << (x & 7)));
+    }
+  }
+
+  return xbm;
+}
+
+// vim: set ts=2 sw=2 expandtab:
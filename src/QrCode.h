@@ -18,8 +18,10 @@
 #pragma once
 
 #include <future>
+#include <vector>
+#include <cstdint>
 
-#include "main.h"
+#include "WebSocket.h"
 
 class QrCode
 {
@@ -29,32 +31,40 @@ public:
    */
   QrCode(const std::shared_ptr<WebSocket>& ws);
 
-  /**
-   * @brief Destructor that deletes the temporary QR code file.
-   */
-  ~QrCode();
-
   /**
    * @brief Fetches machine QR code from the server.
    */
   std::future<void> download();
 
   /**
-   * @brief Returns file system path to QR code.
+   * @brief Scales the QR code to a square XBM bitmap.
+   *
+   * Dark modules are set bits, rows are padded to whole bytes and bits
+   * are least significant first, as XCreateBitmapFromData() expects.
    *
-   * @return Path to QR code (in qrCodePath).
+   * @param size Width and height of the bitmap in pixels.
+   * @return Bitmap data, or an empty vector if no QR code is loaded.
    */
-  const std::string getPath() { return qrCodePath; }
-
+  std::vector<char> getBitmap(unsigned int size) const;
 
 private:
   const std::shared_ptr<WebSocket> webSocket;
-  const std::string qrCodePath;
+
+  unsigned int width = 0;
+  unsigned int height = 0;
+
+  // Row-major packed bitset, one bit per pixel, set for dark pixels.
+  std::vector<uint8_t> bits;
 
   /**
-   * @brief Writes machine QR code to an output file stream.
+   * @brief Decodes the two-color XPM sent by the server into bits.
    */
-  void write(const std::string& data);
+  void parse(const std::string& data);
+
+  bool isDark(unsigned int x, unsigned int y) const {
+    size_t i = static_cast<size_t>(y) * width + x;
+    return bits[i >> 3] & (1u << (i & 7));
+  }
 };
 
 
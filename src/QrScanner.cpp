@@ -15,7 +15,6 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
-#include <iostream>
 #include <cstring>
 #include <vector>
 #include <thread>
@@ -25,8 +24,11 @@
 
 #include "main.h"
 #include "QrScanner.h"
+#include "Player.h"
+#include "Log.h"
 
-QrScanner::QrScanner(const char* qrdev) : qrDevice(qrdev) {
+QrScanner::QrScanner(const char* qrdev, const std::shared_ptr<Player>& player) :
+  qrDevice(qrdev), playerHandler(player) {
   if (pipe(wakePipe) == -1) {
     throw std::runtime_error("Failed to create wake pipe.");
   }
@@ -48,7 +50,7 @@ void QrScanner::start()
 
   run = true;
   scanThread = std::thread(&QrScanner::scan, this);
-  std::cout << "QR scanner started." << std::endl;
+  LOG_INFO << "QR scanner started.";
 }
 
 void QrScanner::stop()
@@ -89,7 +91,7 @@ void QrScanner::scan()
     std::vector<char> uuid(buf, buf + MAX_UUID_LEN);
     int position = buf[MAX_UUID_LEN] - '0';
 
-    std::cout << "QR code detected." << std::endl;
+    LOG_INFO << "QR code detected.";
     playerHandler->login(uuid, position);
     std::this_thread::sleep_for(std::chrono::seconds(1));
   }
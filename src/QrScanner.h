@@ -17,6 +17,12 @@
 
 #pragma once
 
+#include <atomic>
+#include <memory>
+#include <thread>
+
+class Player;
+
 class QrScanner
 {
 public:
@@ -25,8 +31,9 @@ public:
    *
    * @param qrdev Pointer to a null-terminated string that specifies
    *              the path to the QR scanner device.
+   * @param player Logs in the players whose codes are scanned.
    */
-  explicit QrScanner(const char* qrdev);
+  QrScanner(const char* qrdev, const std::shared_ptr<Player>& player);
 
   /**
    * @brief Deconstructor.
@@ -53,6 +60,7 @@ private:
   void scan();
 
   const char* qrDevice;
+  const std::shared_ptr<Player> playerHandler;
   int ttyQR = -1;
   int wakePipe[2] = {-1, -1};
 
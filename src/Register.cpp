@@ -15,13 +15,13 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
-#include <iostream>
 
 #include <json/json.h>
 #include <sys/stat.h>
 
 #include "Register.h"
 #include "Config.h"
+#include "Log.h"
 
 using namespace std;
 
@@ -56,22 +56,20 @@ future<void> Register::registerMachine(const string& regcode, const string& conf
     return future;
   }
 
-  Json::Value msg;
-  msg["path"] = "/api/v1/register";
-  msg["method"] = "POST";
-  msg["body"]["code"] = regcode;
+  Json::Value body;
+  body["code"] = regcode;
 
-  webSocket->send(msg, [promise, configPath](const Json::Value& response) {
+  webSocket->send({"/api/v1/register", "POST", &body}, [promise, configPath](const WebSocket::Response& response) {
     try {
-      if (response["status"].asInt() != 200) {
+      if (response.status != 200) {
         throw runtime_error("Registration failed.");
       }
 
       Json::Value config;
-      Json::Reader().parse(response["body"].asString(), config);
+      Json::Reader().parse(response.body, config);
       Config::save(config["message"], configPath);
 
-      cout << "Machine registered." << endl;
+      LOG_INFO << "Machine registered.";
       promise->set_value();
     }
     catch (const exception& e) {
@@ -0,0 +1,195 @@
+// Spooky Scoreboard Daemon
+// Copyright (C) 2025 Greg MacKenzie
+// https://spookyscoreboard.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "Cbor.h"
+#include "RequestWriter.h"
+
+using namespace std;
+
+void RequestWriter::begin(size_t fields)
+{
+  buf.clear();
+  first = true;
+
+  if (binary) Cbor::encodeMap(fields, buf);
+  else buf += '{';
+}
+
+void RequestWriter::field(const char* k, const char* v)
+{
+  key(k);
+  text(v, strlen(v));
+}
+
+void RequestWriter::field(const char* k, const string& v)
+{
+  key(k);
+  text(v.data(), v.size());
+}
+
+void RequestWriter::field(const char* k, const Json::Value& v)
+{
+  key(k);
+  value(v);
+}
+
+const string& RequestWriter::end()
+{
+  if (!binary) buf += '}';
+  return buf;
+}
+
+const string& RequestWriter::write(const Json::Value& v)
+{
+  buf.clear();
+  value(v);
+  return buf;
+}
+
+void RequestWriter::key(const char* k)
+{
+  if (binary) {
+    Cbor::encodeString(k, strlen(k), buf);
+    return;
+  }
+
+  if (!first) buf += ',';
+  first = false;
+
+  text(k, strlen(k));
+  buf += ':';
+}
+
+void RequestWriter::text(const char* s, size_t len)
+{
+  if (binary) {
+    Cbor::encodeString(s, len, buf);
+    return;
+  }
+
+  static const char hex[] = "0123456789abcdef";
+
+  buf += '"';
+
+  for (size_t i = 0; i < len; i++) {
+    const unsigned char c = static_cast<unsigned char>(s[i]);
+
+    switch (c) {
+    case '"': buf += "\\\""; break;
+    case '\\': buf += "\\\\"; break;
+    case '\b': buf += "\\b"; break;
+    case '\f': buf += "\\f"; break;
+    case '\n': buf += "\\n"; break;
+    case '\r': buf += "\\r"; break;
+    case '\t': buf += "\\t"; break;
+    default:
+      if (c < 0x20) {
+        buf += "\\u00";
+        buf += hex[c >> 4];
+        buf += hex[c & 0xf];
+      }
+      else {
+        buf += static_cast<char>(c);
+      }
+    }
+  }
+
+  buf += '"';
+}
+
+void RequestWriter::value(const Json::Value& v)
+{
+  if (binary) {
+    Cbor::encode(v, buf);
+    return;
+  }
+
+  char num[32];
+
+  switch (v.type()) {
+  case Json::nullValue:
+    buf += "null";
+    break;
+
+  case Json::booleanValue:
+    buf += v.asBool() ? "true" : "false";
+    break;
+
+  case Json::intValue:
+    snprintf(num, sizeof(num), "%lld", static_cast<long long>(v.asInt64()));
+    buf += num;
+    break;
+
+  case Json::uintValue:
+    snprintf(num, sizeof(num), "%llu", static_cast<unsigned long long>(v.asUInt64()));
+    buf += num;
+    break;
+
+  case Json::realValue:
+    // JSON has no NaN or infinity.
+    if (!isfinite(v.asDouble())) {
+      buf += "null";
+      break;
+    }
+    snprintf(num, sizeof(num), "%.17g", v.asDouble());
+    buf += num;
+    break;
+
+  case Json::stringValue: {
+    const char* begin;
+    const char* end;
+    v.getString(&begin, &end);
+    text(begin, static_cast<size_t>(end - begin));
+    break;
+  }
+
+  case Json::arrayValue: {
+    buf += '[';
+    bool firstItem = true;
+    for (const auto& item : v) {
+      if (!firstItem) buf += ',';
+      firstItem = false;
+      value(item);
+    }
+    buf += ']';
+    break;
+  }
+
+  case Json::objectValue: {
+    buf += '{';
+    bool firstMember = true;
+    for (auto it = v.begin(); it != v.end(); ++it) {
+      if (!firstMember) buf += ',';
+      firstMember = false;
+
+      const char* end;
+      const char* begin = it.memberName(&end);
+      text(begin, static_cast<size_t>(end - begin));
+      buf += ':';
+      value(*it);
+    }
+    buf += '}';
+    break;
+  }
+  }
+}
+
+// vim: set ts=2 sw=2 expandtab:
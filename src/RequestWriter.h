@@ -0,0 +1,65 @@
+// Spooky Scoreboard Daemon
+// Copyright (C) 2025 Greg MacKenzie
+// https://spookyscoreboard.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <string>
+
+#include <json/json.h>
+
+/**
+ * Serializes outgoing messages, as JSON text or CBOR, into a buffer that
+ * is kept between messages. Once the buffer has grown to fit, writing
+ * makes no allocations.
+ *
+ * An object is written with begin(), one field() per member, then end().
+ * CBOR needs the member count up front, so begin() takes it.
+ */
+class RequestWriter
+{
+public:
+  void setBinary(bool b) { binary = b; }
+  bool isBinary() const { return binary; }
+
+  void begin(size_t fields);
+  void field(const char* key, const char* value);
+  void field(const char* key, const std::string& value);
+  void field(const char* key, const Json::Value& value);
+
+  /**
+   * @return The serialized message, valid until the next begin().
+   */
+  const std::string& end();
+
+  /**
+   * @brief Serializes a whole value.
+   */
+  const std::string& write(const Json::Value& value);
+
+  const std::string& str() const { return buf; }
+
+private:
+  std::string buf;
+  bool binary = false;
+  bool first = true;
+
+  void key(const char* k);
+  void text(const char* s, size_t len);
+  void value(const Json::Value& v);
+};
+
+// vim: set ts=2 sw=2 expandtab:
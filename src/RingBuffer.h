@@ -0,0 +1,150 @@
+// Spooky Scoreboard Daemon
+// Copyright (C) 2025 Greg MacKenzie
+// https://spookyscoreboard.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+/**
+ * Bounded lock-free multi-producer, multi-consumer queue.
+ *
+ * Each cell carries a sequence number telling producers and consumers
+ * whose turn it is, so neither side ever takes a lock or blocks. When
+ * the queue is full, push fails and the caller decides what to drop.
+ *
+ * @tparam T Element type; must be default constructible.
+ * @tparam Capacity Number of cells, a power of two.
+ */
+template <typename T, size_t Capacity>
+class RingBuffer
+{
+  static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                "RingBuffer capacity must be a power of two");
+
+public:
+  RingBuffer()
+  {
+    for (size_t i = 0; i < Capacity; i++) {
+      cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  RingBuffer(const RingBuffer&) = delete;
+  RingBuffer& operator=(const RingBuffer&) = delete;
+
+  /**
+   * @brief Claims a free cell and fills it in place.
+   *
+   * @param fill Callable invoked as fill(T&) on the claimed cell.
+   * @return False if the queue is full.
+   */
+  template <typename F>
+  bool produce(F&& fill)
+  {
+    size_t pos = head.load(std::memory_order_relaxed);
+
+    for (;;) {
+      Cell& cell = cells[pos & (Capacity - 1)];
+      size_t seq = cell.seq.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+
+      if (diff == 0) {
+        if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          fill(cell.data);
+          cell.seq.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      }
+      else if (diff < 0) {
+        return false;
+      }
+      else {
+        pos = head.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /**
+   * @brief Takes the oldest element and hands it to a callable.
+   *
+   * @param drain Callable invoked as drain(T&) on the oldest cell.
+   * @return False if the queue is empty.
+   */
+  template <typename F>
+  bool consume(F&& drain)
+  {
+    size_t pos = tail.load(std::memory_order_relaxed);
+
+    for (;;) {
+      Cell& cell = cells[pos & (Capacity - 1)];
+      size_t seq = cell.seq.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+
+      if (diff == 0) {
+        if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          drain(cell.data);
+          cell.seq.store(pos + Capacity, std::memory_order_release);
+          return true;
+        }
+      }
+      else if (diff < 0) {
+        return false;
+      }
+      else {
+        pos = tail.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  bool push(T value)
+  {
+    return produce([&value](T& cell) { cell = std::move(value); });
+  }
+
+  bool pop(T& out)
+  {
+    return consume([&out](T& cell) { out = std::move(cell); });
+  }
+
+  /**
+   * @brief Approximate number of queued elements.
+   */
+  size_t size() const
+  {
+    size_t h = head.load(std::memory_order_relaxed);
+    size_t t = tail.load(std::memory_order_relaxed);
+    return h > t ? h - t : 0;
+  }
+
+  bool empty() const { return size() == 0; }
+
+private:
+  struct Cell {
+    std::atomic<size_t> seq;
+    T data{};
+  };
+
+  Cell cells[Capacity];
+
+  alignas(64) std::atomic<size_t> head{0};
+  alignas(64) std::atomic<size_t> tail{0};
+};
+
+// vim: set ts=2 sw=2 expandtab:
@@ -0,0 +1,283 @@
+// Spooky Scoreboard Daemon
+// Copyright (C) 2025 Greg MacKenzie
+// https://spookyscoreboard.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <uuid/uuid.h>
+
+#include "ScoreHistory.h"
+#include "Log.h"
+
+#define HISTORY_MAGIC 0x48425353 // "SSBH"
+#define HISTORY_VERSION 1
+
+using namespace std;
+
+namespace
+{
+  uint64_t toScore(const Json::Value& v)
+  {
+    // Config games report scores as strings.
+    if (v.isString()) return strtoull(v.asCString(), nullptr, 10);
+    if (v.isIntegral() && v.asInt64() >= 0) return v.asUInt64();
+    return 0;
+  }
+
+  bool isSet(const array<uint8_t, 16>& uuid)
+  {
+    return any_of(uuid.begin(), uuid.end(), [](uint8_t b) { return b != 0; });
+  }
+
+  string key(const array<uint8_t, 16>& uuid)
+  {
+    return string(reinterpret_cast<const char*>(uuid.data()), uuid.size());
+  }
+}
+
+ScoreHistory::ScoreHistory(const string& p) : path(p)
+{
+  fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0) throw runtime_error("Failed to open " + path);
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    throw runtime_error("Failed to stat " + path);
+  }
+
+  size_t size = static_cast<size_t>(st.st_size);
+  const bool fresh = size < sizeof(Header);
+
+  if (fresh) {
+    size = sizeof(Header) + 64 * sizeof(Record);
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+      close(fd);
+      throw runtime_error("Failed to size " + path);
+    }
+  }
+
+  map(size);
+
+  if (fresh) {
+    header->magic = HISTORY_MAGIC;
+    header->version = HISTORY_VERSION;
+    header->count = 0;
+  }
+  else if (header->magic != HISTORY_MAGIC || header->version != HISTORY_VERSION) {
+    unmap();
+    close(fd);
+    throw runtime_error("Unrecognized score history " + path);
+  }
+
+  // A count past the end means an append was cut short.
+  header->count = min<uint64_t>(header->count, (mapped - sizeof(Header)) / sizeof(Record));
+
+  for (uint64_t i = 0; i < header->count; i++) indexRecord(records()[i]);
+
+  LOG_INFO << "Score history: " << header->count << " games, " << index.size() << " players.";
+}
+
+ScoreHistory::~ScoreHistory()
+{
+  unmap();
+  if (fd >= 0) close(fd);
+}
+
+void ScoreHistory::map(size_t bytes)
+{
+  void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED) throw runtime_error("Failed to map " + path);
+
+  header = static_cast<Header*>(p);
+  mapped = bytes;
+}
+
+void ScoreHistory::unmap()
+{
+  if (header) munmap(header, mapped);
+  header = nullptr;
+  mapped = 0;
+}
+
+/**
+ * Grows the file and mapping to hold count records, doubling as it goes.
+ */
+void ScoreHistory::reserve(uint64_t count)
+{
+  size_t needed = sizeof(Header) + count * sizeof(Record);
+  if (needed <= mapped) return;
+
+  size_t size = max(needed, mapped * 2);
+  unmap();
+
+  if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+    map(static_cast<size_t>(lseek(fd, 0, SEEK_END)));
+    throw runtime_error("Failed to grow " + path);
+  }
+
+  map(size);
+}
+
+void ScoreHistory::append(const Json::Value& scores, const array<string, 4>& uuids)
+{
+  Record rec = {};
+  rec.time = time(nullptr);
+
+  for (int i = 0; i < 4; i++) {
+    rec.score[i] = toScore(scores[i]);
+    if (!uuids[i].empty()) uuid_parse(uuids[i].c_str(), rec.uuid[i].data());
+  }
+
+  lock_guard<mutex> lock(mtx);
+
+  try {
+    reserve(header->count + 1);
+  }
+  catch (const runtime_error& e) {
+    LOG_ERROR << e.what();
+    return;
+  }
+
+  // The record reaches the disk before the count does, so neither a
+  // crash nor a power cut exposes a half-written game.
+  Record* slot = &records()[header->count];
+  *slot = rec;
+  sync(slot, sizeof(Record));
+
+  ++header->count;
+  sync(header, sizeof(Header));
+  indexRecord(rec);
+
+  if (header->count >= compactAt) compact();
+}
+
+ScoreHistory::Best ScoreHistory::personalBest(const string& uuid)
+{
+  array<uint8_t, 16> id;
+  if (uuid_parse(uuid.c_str(), id.data()) != 0) return {};
+
+  lock_guard<mutex> lock(mtx);
+  auto it = index.find(key(id));
+  return it != index.end() ? it->second : Best{};
+}
+
+size_t ScoreHistory::size()
+{
+  lock_guard<mutex> lock(mtx);
+  return header->count;
+}
+
+/**
+ * Writes part of the mapping through to disk.
+ */
+void ScoreHistory::sync(const void* p, size_t len)
+{
+  static const uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+
+  const uintptr_t start = reinterpret_cast<uintptr_t>(p) & ~(page - 1);
+  const uintptr_t end = reinterpret_cast<uintptr_t>(p) + len;
+
+  if (msync(reinterpret_cast<void*>(start), end - start, MS_SYNC) != 0) {
+    LOG_ERROR << "Failed to sync " << path;
+  }
+}
+
+void ScoreHistory::indexRecord(const Record& rec)
+{
+  for (int i = 0; i < 4; i++) {
+    if (!isSet(rec.uuid[i])) continue;
+
+    Best& best = index[key(rec.uuid[i])];
+    if (rec.score[i] > best.score) best = {rec.score[i], rec.time};
+  }
+}
+
+/**
+ * Rewrites the log with the most recent HISTORY_KEEP games, plus any
+ * older game holding a personal best, then swaps it in.
+ * Called with the lock held.
+ */
+void ScoreHistory::compact()
+{
+  const uint64_t count = header->count;
+  const uint64_t recent = count > HISTORY_KEEP ? count - HISTORY_KEEP : 0;
+
+  vector<Record> kept;
+  kept.reserve(HISTORY_KEEP);
+
+  for (uint64_t i = 0; i < count; i++) {
+    const Record& rec = records()[i];
+    bool keep = i >= recent;
+
+    for (int p = 0; p < 4 && !keep; p++) {
+      if (!isSet(rec.uuid[p])) continue;
+      const Best& best = index[key(rec.uuid[p])];
+      keep = best.score == rec.score[p] && best.time == rec.time;
+    }
+
+    if (keep) kept.push_back(rec);
+  }
+
+  const string tmp = path + ".tmp";
+  int tfd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (tfd < 0) {
+    LOG_ERROR << "Failed to open " << tmp;
+    return;
+  }
+
+  Header h = {HISTORY_MAGIC, HISTORY_VERSION, kept.size()};
+  bool ok = write(tfd, &h, sizeof(h)) == static_cast<ssize_t>(sizeof(h));
+
+  const size_t bytes = kept.size() * sizeof(Record);
+  ok = ok && write(tfd, kept.data(), bytes) == static_cast<ssize_t>(bytes);
+  ok = ok && fsync(tfd) == 0;
+  close(tfd);
+
+  if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+    LOG_ERROR << "Failed to compact " << path;
+    unlink(tmp.c_str());
+    return;
+  }
+
+  int nfd = open(path.c_str(), O_RDWR | O_CLOEXEC);
+  if (nfd < 0) {
+    LOG_ERROR << "Failed to reopen " << path;
+    return;
+  }
+
+  unmap();
+  close(fd);
+  fd = nfd;
+  map(sizeof(Header) + bytes);
+  reserve(kept.size() + 64);
+
+  // Many personal bests can keep the log large; don't compact every game.
+  compactAt = kept.size() + HISTORY_COMPACT_AT - HISTORY_KEEP;
+
+  LOG_INFO << "Score history compacted: " << count << " to " << kept.size() << " games.";
+}
+
+// vim: set ts=2 sw=2 expandtab:
@@ -0,0 +1,106 @@
+// Spooky Scoreboard Daemon
+// Copyright (C) 2025 Greg MacKenzie
+// https://spookyscoreboard.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <json/json.h>
+
+// Compact once the log holds this many games, keeping the most recent
+// HISTORY_KEEP and every personal best.
+#define HISTORY_COMPACT_AT 50000
+#define HISTORY_KEEP 10000
+
+/**
+ * An append-only, memory-mapped log of every game played on the machine,
+ * with an in-memory index of each logged-in player's personal best.
+ */
+class ScoreHistory
+{
+public:
+  // One game. Positions nobody was logged in to have a zero UUID.
+  struct Record {
+    int64_t time;
+    std::array<uint64_t, 4> score;
+    std::array<std::array<uint8_t, 16>, 4> uuid;
+  };
+
+  struct Best {
+    uint64_t score = 0;
+    int64_t time = 0;
+  };
+
+  /**
+   * @brief Opens the log at path, creating it if needed.
+   *        Throws runtime_error on failure.
+   */
+  explicit ScoreHistory(const std::string& path);
+  ~ScoreHistory();
+
+  ScoreHistory(const ScoreHistory&) = delete;
+  ScoreHistory& operator=(const ScoreHistory&) = delete;
+
+  /**
+   * @brief Records a game.
+   *
+   * @param scores Last game scores as returned by processLastGameScores().
+   * @param uuids Who was logged in at each position; empty if nobody.
+   */
+  void append(const Json::Value& scores, const std::array<std::string, 4>& uuids);
+
+  /**
+   * @brief Retrieves a player's best on this machine.
+   *
+   * @param uuid The player's UUID, as text.
+   */
+  Best personalBest(const std::string& uuid);
+
+  size_t size();
+
+private:
+  // File layout: a Header, then Records back to back.
+  struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t count;
+  };
+
+  std::string path;
+  int fd = -1;
+  Header* header = nullptr;
+  size_t mapped = 0;
+
+  std::mutex mtx;
+  std::unordered_map<std::string, Best> index;
+  uint64_t compactAt = HISTORY_COMPACT_AT;
+
+  Record* records() const { return reinterpret_cast<Record*>(header + 1); }
+
+  void map(size_t bytes);
+  void unmap();
+  void reserve(uint64_t count);
+  void sync(const void* p, size_t len);
+  void indexRecord(const Record& rec);
+  void compact();
+};
+
+// vim: set ts=2 sw=2 expandtab:
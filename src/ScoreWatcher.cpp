@@ -0,0 +1,255 @@
+// Spooky Scoreboard Daemon
+// Copyright (C) 2025 Greg MacKenzie
+// https://spookyscoreboard.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+
+#include <cerrno>
+
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+
+#include "Machine.h"
+#include "ScoreWatcher.h"
+#include "WebSocket.h"
+#include "AuditCollector.h"
+#include "ScoreHistory.h"
+#include "Log.h"
+
+using namespace std;
+
+ScoreWatcher::ScoreWatcher(Machine& m) :
+  machine(m),
+  parseHighScores(Metrics::histogram(
+    "ssbd_parse_seconds", "Time to parse a scores file.",
+    {{"game", m.game->getGameName()}, {"file", m.game->getHighScoresFile()}})),
+  parseLastScores(Metrics::histogram(
+    "ssbd_parse_seconds", "Time to parse a scores file.",
+    {{"game", m.game->getGameName()}, {"file", m.game->getLastScoresFile()}}))
+{
+  if ((fd = inotify_init1(IN_CLOEXEC)) == -1) {
+    throw runtime_error("Failed inotify_init().");
+  }
+
+  // Games that write a temporary file and rename it over the old one
+  // only show up as IN_MOVED_TO.
+  if ((wd = inotify_add_watch(
+    fd, machine.game->getScoresPath().c_str(), IN_CLOSE_WRITE | IN_MOVED_TO)) == -1) {
+
+    close(fd);
+    throw runtime_error("Failed inotify_add_watch().");
+  }
+
+  // Baseline for the first bundle's audit delta.
+  try {
+    lastAudits = machine.game->processAudits();
+  }
+  catch (const runtime_error& e) {
+    LOG_WARNING << "Audits unavailable: " << e.what();
+  }
+}
+
+ScoreWatcher::~ScoreWatcher()
+{
+  close(fd);
+}
+
+void ScoreWatcher::handleEvents()
+{
+  // Aligned for the inotify_event structs read into it.
+  alignas(struct inotify_event) char buf[1024];
+
+  int timeout = -1;
+  if (pending) {
+    auto left = chrono::duration_cast<chrono::milliseconds>(deadline - Trace::Clock::now());
+    timeout = static_cast<int>(max<int64_t>(left.count(), 0));
+  }
+
+  struct pollfd pfd = {fd, POLLIN, 0};
+  int rc = poll(&pfd, 1, timeout);
+
+  if (rc < 0 && errno != EINTR) {
+    LOG_ERROR << "Failed waiting for events.";
+  }
+  else if (rc > 0) {
+    ssize_t n = read(fd, buf, sizeof(buf));
+
+    if (n < 0) {
+      LOG_ERROR << "Failed reading event.";
+    }
+    else {
+      LOG_INFO << "Processing event...";
+      processEvent(buf, n);
+    }
+  }
+
+  flush();
+}
+
+void ScoreWatcher::flush()
+{
+  if (pending && Trace::Clock::now() >= deadline) sendBundle();
+}
+
+/**
+ * Parses whatever changed during the window and uploads it in one request.
+ */
+void ScoreWatcher::sendBundle()
+{
+  Trace::Scope scope(traceId);
+  Trace::record("bundle_window", traceId, deadline - chrono::milliseconds(SCORE_BUNDLE_WINDOW_MS), deadline);
+
+  Json::Value bundle(Json::objectValue);
+
+  if (highScoresChanged) {
+    try {
+      Json::Value currentScore;
+      {
+        Metrics::Timer timer(parseHighScores);
+        Trace::Span span("parse");
+        currentScore = machine.game->processHighScores();
+      }
+      if (currentScore != lastScore) {
+        bundle["high"] = currentScore;
+        lastScore = currentScore;
+      }
+    }
+    catch (const runtime_error& e) {
+      LOG_ERROR << "Exception: " << e.what();
+    }
+  }
+
+  if (lastScoresChanged) {
+    try {
+      Metrics::Timer timer(parseLastScores);
+      Trace::Span span("parse");
+      bundle["last"] = machine.game->processLastGameScores();
+    }
+    catch (const runtime_error& e) {
+      LOG_ERROR << "Exception: " << e.what();
+    }
+  }
+
+  pending = highScoresChanged = lastScoresChanged = false;
+
+  // Audits alone don't make a bundle; they ride along with scores.
+  if (bundle.empty()) return;
+
+  addAudits(bundle);
+  machine.game->uploadScores(*machine.webSocket, bundle, GameBase::ScoreType::Bundle);
+
+  if (bundle.isMember("last")) {
+    if (machine.history) machine.history->append(bundle["last"], machine.playerList.uuids());
+    machine.playerList.reset();
+    if (machine.auditCollector) machine.auditCollector->notify();
+  }
+}
+
+/**
+ * Adds the audit counters that changed since the last bundle, as
+ * increments: {"delta": {...}}. Without a baseline, or once the audits
+ * were reset, all of them go instead: {"full": {...}}.
+ */
+void ScoreWatcher::addAudits(Json::Value& bundle)
+{
+  GameBase::Audits current;
+
+  try {
+    Trace::Span span("parse");
+    current = machine.game->processAudits();
+  }
+  catch (const runtime_error& e) {
+    LOG_ERROR << "Exception: " << e.what();
+    return;
+  }
+
+  if (current.empty() || current == lastAudits) return;
+
+  Json::Value delta = lastAudits.empty() ? Json::Value(Json::nullValue) : AuditCollector::diff(lastAudits, current);
+  if (delta.isNull()) {
+    for (const auto& counter : current) {
+      bundle["audits"]["full"][counter.first] = static_cast<Json::Int64>(counter.second);
+    }
+  }
+  else {
+    bundle["audits"]["delta"] = delta;
+  }
+
+  lastAudits = move(current);
+}
+
+/**
+ * Records how long after the write an event is handled, using the
+ * file's modification time. Slow storage shows up here.
+ */
+void ScoreWatcher::observeEventLatency(const char* name)
+{
+  static Metrics::Histogram& latency = Metrics::histogram(
+    "ssbd_event_latency_seconds", "Time from a scores file write to its event being handled.");
+
+  struct stat st;
+  string path = machine.game->getScoresPath() + "/" + name;
+  if (stat(path.c_str(), &st) != 0) return;
+
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+
+  int64_t ns = (now.tv_sec - st.st_mtim.tv_sec) * 1000000000LL + (now.tv_nsec - st.st_mtim.tv_nsec);
+  if (ns >= 0) latency.observe(static_cast<uint64_t>(ns));
+}
+
+/**
+ * Processes inotify events for file changes.
+ * Score file changes open a bundle window, or join the open one.
+ *
+ * @param buf The buffer containing the inotify events
+ * @param bytes The number of bytes in the buffer
+ */
+void ScoreWatcher::processEvent(char* buf, ssize_t bytes)
+{
+  char* ptr = buf;
+
+  while (ptr < buf + bytes) {
+    struct inotify_event* evt = (struct inotify_event*)ptr;
+
+    if (evt->len > 0) {
+      LOG_DEBUG << "Event: " << evt->name;
+      bool high = strcmp(evt->name, machine.game->getHighScoresFile().c_str()) == 0;
+      bool last = strcmp(evt->name, machine.game->getLastScoresFile().c_str()) == 0;
+
+      if (high || last) {
+        if (!pending) {
+          pending = true;
+          deadline = Trace::Clock::now() + chrono::milliseconds(SCORE_BUNDLE_WINDOW_MS);
+          traceId = Trace::start();
+        }
+
+        Trace::Span span(high ? "high_scores_event" : "last_scores_event", traceId);
+        observeEventLatency(evt->name);
+        highScoresChanged |= high;
+        lastScoresChanged |= last;
+      }
+    }
+
+    ptr += sizeof(struct inotify_event) + evt->len;
+  }
+}
+
+// vim: set ts=2 sw=2 expandtab:
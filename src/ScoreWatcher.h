@@ -0,0 +1,99 @@
+// Spooky Scoreboard Daemon
+// Copyright (C) 2025 Greg MacKenzie
+// https://spookyscoreboard.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+
+#include <sys/types.h>
+#include <json/json.h>
+
+#include "GameBase.h"
+#include "Metrics.h"
+#include "Trace.h"
+
+// How long after the first score file event to wait for the rest of a
+// game's writes before uploading them together.
+#define SCORE_BUNDLE_WINDOW_MS 750
+
+struct Machine;
+
+/**
+ * Watches a machine's scores directory and uploads scores as the game
+ * writes them.
+ *
+ * A game end touches several files, often more than once. Events are
+ * collected for SCORE_BUNDLE_WINDOW_MS after the first, then the last
+ * scores, any changed high scores and the change in games played go
+ * up as one bundle.
+ */
+class ScoreWatcher
+{
+public:
+  /**
+   * @brief Starts watching. Throws runtime_error on failure.
+   */
+  explicit ScoreWatcher(Machine& m);
+  ~ScoreWatcher();
+
+  ScoreWatcher(const ScoreWatcher&) = delete;
+  ScoreWatcher& operator=(const ScoreWatcher&) = delete;
+
+  /**
+   * @brief The inotify descriptor, readable when events are waiting.
+   */
+  int getFd() const { return fd; }
+
+  /**
+   * @brief Handles events as they arrive, returning once a batch has been
+   *        read or a pending bundle has been sent.
+   */
+  void handleEvents();
+
+  /**
+   * @brief Sends the pending bundle if its window has closed.
+   */
+  void flush();
+
+private:
+  Machine& machine;
+  int fd = -1;
+  int wd = -1;
+
+  // The bundle being collected, if any.
+  bool pending = false;
+  bool highScoresChanged = false;
+  bool lastScoresChanged = false;
+  Trace::Clock::time_point deadline;
+  uint64_t traceId = 0;
+
+  // The last high scores uploaded, to avoid duplicate uploads.
+  Json::Value lastScore;
+
+  // Audit counters as of the last bundle; empty until first read.
+  GameBase::Audits lastAudits;
+
+  Metrics::Histogram& parseHighScores;
+  Metrics::Histogram& parseLastScores;
+
+  void processEvent(char* buf, ssize_t bytes);
+  void sendBundle();
+  void addAudits(Json::Value& bundle);
+  void observeEventLatency(const char* name);
+};
+
+// vim: set ts=2 sw=2 expandtab:
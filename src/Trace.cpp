@@ -0,0 +1,260 @@
+// Spooky Scoreboard Daemon
+// Copyright (C) 2025 Greg MacKenzie
+// https://spookyscoreboard.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <fstream>
+#include <csignal>
+#include <cerrno>
+#include <ctime>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <json/json.h>
+
+#include "Trace.h"
+#include "Log.h"
+
+// Spans kept per thread; older spans are overwritten.
+#define TRACE_BUFFER_SIZE 1024
+
+// Buffers of exited threads kept for the next dump.
+#define TRACE_MAX_DEAD_BUFFERS 8
+
+using namespace std;
+
+namespace
+{
+  struct Event {
+    const char* name;
+    uint64_t id;
+    Trace::Clock::time_point begin;
+    Trace::Clock::duration dur;
+  };
+
+  /**
+   * One thread's spans. The lock is only contended while dumping.
+   */
+  struct Buffer {
+    mutex mtx;
+    long tid = 0;
+    bool alive = true;
+    size_t next = 0;
+    vector<Event> events;
+  };
+
+  struct Registry {
+    mutex mtx;
+    vector<shared_ptr<Buffer>> buffers;
+  };
+
+  // Never destroyed; threads may record while the process exits.
+  Registry& registry()
+  {
+    static Registry* r = new Registry();
+    return *r;
+  }
+
+  /**
+   * Owns the calling thread's buffer and marks it dead on thread exit.
+   */
+  struct LocalBuffer {
+    shared_ptr<Buffer> buf;
+
+    LocalBuffer() : buf(make_shared<Buffer>())
+    {
+      buf->tid = syscall(SYS_gettid);
+      buf->events.reserve(TRACE_BUFFER_SIZE);
+
+      Registry& r = registry();
+      lock_guard<mutex> lock(r.mtx);
+
+      // Forget the oldest dead threads; window threads come and go.
+      size_t dead = 0;
+      for (auto it = r.buffers.rbegin(); it != r.buffers.rend(); ++it) {
+        if (!(*it)->alive) ++dead;
+      }
+      for (auto it = r.buffers.begin(); it != r.buffers.end() && dead > TRACE_MAX_DEAD_BUFFERS;) {
+        if (!(*it)->alive) {
+          it = r.buffers.erase(it);
+          --dead;
+        }
+        else {
+          ++it;
+        }
+      }
+
+      r.buffers.push_back(buf);
+    }
+
+    ~LocalBuffer()
+    {
+      lock_guard<mutex> lock(buf->mtx);
+      buf->alive = false;
+    }
+  };
+
+  thread_local LocalBuffer localBuffer;
+  thread_local uint64_t currentId = 0;
+
+  atomic<uint64_t> nextId{1};
+
+  thread listener;
+  int sigPipe[2] = {-1, -1};
+
+  void onSignal(int)
+  {
+    int saved = errno;
+    if (write(sigPipe[1], "d", 1) < 0) {}
+    errno = saved;
+  }
+
+  /**
+   * Waits for bytes on the signal pipe: 'd' dumps a trace, 'q' quits.
+   */
+  void listen(const string& dir)
+  {
+    char c;
+    while (true) {
+      ssize_t n = read(sigPipe[0], &c, 1);
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0 || c == 'q') break;
+      Trace::dump(dir);
+    }
+  }
+}
+
+uint64_t Trace::start()
+{
+  return nextId.fetch_add(1, memory_order_relaxed);
+}
+
+uint64_t Trace::current()
+{
+  return currentId;
+}
+
+void Trace::record(const char* name, uint64_t id, Clock::time_point begin, Clock::time_point end)
+{
+  Buffer& buf = *localBuffer.buf;
+  lock_guard<mutex> lock(buf.mtx);
+
+  Event evt = {name, id, begin, end - begin};
+  if (buf.events.size() < TRACE_BUFFER_SIZE) {
+    buf.events.push_back(evt);
+  }
+  else {
+    buf.events[buf.next] = evt;
+  }
+  buf.next = (buf.next + 1) % TRACE_BUFFER_SIZE;
+}
+
+Trace::Scope::Scope(uint64_t id) : prev(currentId)
+{
+  currentId = id;
+}
+
+Trace::Scope::~Scope()
+{
+  currentId = prev;
+}
+
+string Trace::dump(const string& dir)
+{
+  Json::Value events(Json::arrayValue);
+  const Json::Int pid = getpid();
+
+  vector<shared_ptr<Buffer>> buffers;
+  {
+    Registry& r = registry();
+    lock_guard<mutex> lock(r.mtx);
+    buffers = r.buffers;
+  }
+
+  for (const auto& buf : buffers) {
+    lock_guard<mutex> lock(buf->mtx);
+
+    for (const Event& e : buf->events) {
+      Json::Value evt;
+      evt["name"] = e.name;
+      evt["cat"] = "ssbd";
+      evt["ph"] = "X";
+      evt["pid"] = pid;
+      evt["tid"] = static_cast<Json::Int64>(buf->tid);
+      evt["ts"] = chrono::duration<double, micro>(e.begin.time_since_epoch()).count();
+      evt["dur"] = chrono::duration<double, micro>(e.dur).count();
+      if (e.id) evt["args"]["trace_id"] = static_cast<Json::UInt64>(e.id);
+      events.append(evt);
+    }
+  }
+
+  Json::Value root;
+  root["traceEvents"] = events;
+  root["displayTimeUnit"] = "ms";
+
+  string path = dir + "/ssbd-trace-" + to_string(time(nullptr)) + ".json";
+  ofstream out(path);
+  if (!out) {
+    LOG_ERROR << "Failed to write trace to " << path;
+    return "";
+  }
+
+  Json::StreamWriterBuilder writerBuilder;
+  writerBuilder["indentation"] = "";
+  out << Json::writeString(writerBuilder, root);
+
+  LOG_INFO << "Trace written to " << path << " (" << events.size() << " spans)";
+  return path;
+}
+
+void Trace::startSignalListener(const string& dir)
+{
+  if (listener.joinable()) return;
+
+  if (pipe2(sigPipe, O_CLOEXEC) == -1) {
+    LOG_ERROR << "Failed to create trace signal pipe.";
+    return;
+  }
+
+  listener = thread(listen, dir);
+
+  struct sigaction sa = {};
+  sa.sa_handler = onSignal;
+  sa.sa_flags = SA_RESTART;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGUSR1, &sa, nullptr);
+}
+
+void Trace::stopSignalListener()
+{
+  if (!listener.joinable()) return;
+
+  signal(SIGUSR1, SIG_IGN);
+  if (write(sigPipe[1], "q", 1) < 0) {}
+  listener.join();
+
+  for (int& fd : sigPipe) {
+    close(fd);
+    fd = -1;
+  }
+}
+
+// vim: set ts=2 sw=2 expandtab:
@@ -0,0 +1,104 @@
+// Spooky Scoreboard Daemon
+// Copyright (C) 2025 Greg MacKenzie
+// https://spookyscoreboard.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <string>
+#include <chrono>
+#include <cstdint>
+
+// Span-tracing of score events, from inotify to the server's response.
+//
+// Each thread records into its own fixed-size buffer, keeping the most
+// recent spans. Spans belonging to one event share a trace id, which
+// follows the work across threads via Trace::Scope.
+namespace Trace
+{
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   * @brief Starts a new trace. Use Trace::Scope to make it current.
+   *
+   * @return The new trace id.
+   */
+  uint64_t start();
+
+  /**
+   * @brief Retrieves the trace id current on this thread, or 0.
+   */
+  uint64_t current();
+
+  /**
+   * @brief Records a completed span on this thread.
+   *
+   * @param name A string literal; it is stored by pointer.
+   */
+  void record(const char* name, uint64_t id, Clock::time_point begin, Clock::time_point end);
+
+  /**
+   * Records a span from construction to destruction.
+   */
+  class Span
+  {
+  public:
+    explicit Span(const char* spanName, uint64_t traceId = current()) :
+      name(spanName), id(traceId), begin(Clock::now()) {}
+
+    ~Span() { record(name, id, begin, Clock::now()); }
+
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+  private:
+    const char* name;
+    uint64_t id;
+    Clock::time_point begin;
+  };
+
+  /**
+   * Makes a trace id current on this thread until destruction, so work
+   * continued on another thread (e.g. a response callback) joins the trace.
+   */
+  class Scope
+  {
+  public:
+    explicit Scope(uint64_t id);
+    ~Scope();
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+  private:
+    uint64_t prev;
+  };
+
+  /**
+   * @brief Writes all buffered spans as Chrome/Perfetto trace JSON.
+   *
+   * @param dir Directory to write ssbd-trace-<time>.json into.
+   * @return The path written, or an empty string on failure.
+   */
+  std::string dump(const std::string& dir);
+
+  /**
+   * @brief Dumps a trace into dir whenever SIGUSR1 is received.
+   */
+  void startSignalListener(const std::string& dir);
+  void stopSignalListener();
+}
+
+// vim: set ts=2 sw=2 expandtab:
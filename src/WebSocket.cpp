@@ -15,45 +15,149 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
-#include <iostream>
+#include <cstring>
+
 #include <uuid/uuid.h>
 
-#include "main.h"
-#include "x11.h"
-#include "Config.h"
+#include "Cbor.h"
+#include "Envelope.h"
+#include "Machine.h"
+#include "Player.h"
 #include "WebSocket.h"
 #include "version.h"
+#include "Log.h"
+#include "Trace.h"
 
 using namespace std;
 
-WebSocket::WebSocket(const string& uri) : baseUri(uri)
+namespace
+{
+  Metrics::Counter& connects = Metrics::counter(
+    "ssbd_ws_connects_total", "WebSocket connections opened.");
+  Metrics::Counter& disconnects = Metrics::counter(
+    "ssbd_ws_disconnects_total", "WebSocket connections closed.");
+  Metrics::Counter& reconnects = Metrics::counter(
+    "ssbd_ws_reconnects_total", "Reconnects initiated by the daemon.");
+  Metrics::Counter& failovers = Metrics::counter(
+    "ssbd_ws_failovers_total", "Switches away from an endpoint that kept failing.");
+  Metrics::Gauge& pending = Metrics::gauge(
+    "ssbd_pending_requests", "Requests sent and awaiting a response.");
+  Metrics::Gauge& queued = Metrics::gauge(
+    "ssbd_outbox_requests", "Messages waiting on a rate limit or for the server to be reachable.");
+  Metrics::Counter& dropped = Metrics::counter(
+    "ssbd_outbox_dropped_total", "Messages dropped because their lane was full.");
+  Metrics::Counter& heartbeatTimeouts = Metrics::counter(
+    "ssbd_ws_heartbeat_timeouts_total", "Connections closed because a ping went unanswered.");
+  Metrics::Histogram& rtt = Metrics::histogram(
+    "ssbd_ws_rtt_seconds", "Round trip time of WebSocket pings.");
+  Metrics::Histogram& handshake = Metrics::histogram(
+    "ssbd_ws_handshake_seconds", "Time from starting a connection to it opening.");
+
+  // Messages held back by their lane's rate limit, per lane.
+  array<Metrics::Counter*, Lanes::Count> throttled = [] {
+    array<Metrics::Counter*, Lanes::Count> counters;
+    for (int i = 0; i < Lanes::Count; i++) {
+      counters[i] = &Metrics::counter("ssbd_ws_throttled_total", "Messages delayed by a rate limit.",
+                                      {{"lane", Lanes::name(static_cast<Lanes::Lane>(i))}});
+    }
+    return counters;
+  }();
+
+  const char* bytesHelp = "WebSocket message bytes, before (payload) and after (wire) compression.";
+
+  /**
+   * Uploads are worth keeping through an outage; other requests go stale.
+   */
+  bool isUpload(const char* path)
+  {
+    return strcmp(path, "/api/v1/score") == 0;
+  }
+}
+
+WebSocket::WebSocket(const vector<string>& uris, Machine& m) : machine(m)
 {
-  ws.setUrl(uri);
-  ws.setPingInterval(45);
-  setHeaders();
-  setupCallbacks();
+  if (uris.empty()) throw runtime_error("No backend URL.");
+
+  endpoints.set(uris);
+  atomic_store(&machineId, make_shared<const string>(machine.config.machineId));
+  requestCompression(true);
+  setSocket(makeSocket(uris.front()));
   initDispatchers();
 }
 
 WebSocket::~WebSocket()
 {
-  stopPing();
-  ws.stop();
+  stop();
+}
+
+/**
+ * Closes the connection and stops the executor. Queued callbacks still
+ * run, so the owner calls this before tearing down what they touch.
+ */
+void WebSocket::stop()
+{
+  // Stop the executor first so a probe result can't start a new socket.
+  executor.stop();
+  if (prober.joinable()) prober.join();
+
+  shared_ptr<ix::WebSocket> pending;
+  {
+    lock_guard<mutex> lock(replacementMtx);
+    pending = move(replacement);
+  }
+  if (pending) pending->stop();
+
+  socket()->stop();
+  connected.store(false);
+}
+
+/**
+ * Creates a socket with the current credentials and settings. Its
+ * events are handled here, whether it's the active socket or one being
+ * readied to replace it.
+ */
+shared_ptr<ix::WebSocket> WebSocket::makeSocket(const string& url)
+{
+  auto sock = make_shared<ix::WebSocket>();
+  sock->setUrl(url);
+  sock->setPerMessageDeflateOptions(deflateOptions());
+  sock->setExtraHeaders(headers(url));
+  setupCallbacks(*sock);
+  return sock;
+}
+
+void WebSocket::setSocket(shared_ptr<ix::WebSocket> sock)
+{
+  active.store(sock.get());
+  atomic_store(&ws, move(sock));
+}
+
+/**
+ * Reloads the config, then publishes the machine's UUID to the network
+ * thread.
+ */
+void WebSocket::loadConfig()
+{
+  machine.config.load();
+  atomic_store(&machineId, make_shared<const string>(machine.config.machineId));
+}
+
+bool WebSocket::replacing()
+{
+  lock_guard<mutex> lock(replacementMtx);
+  return replacement != nullptr;
 }
 
 void WebSocket::initDispatchers()
 {
   // Logs the user out.
   cmdDispatchers["logout"] = [this](const Json::Value& payload) {
-    if (payload.isMember("position")) playerHandler->logout(payload["position"].asInt());
+    if (payload.isMember("position")) machine.playerHandler->logout(payload["position"].asInt());
   };
 
-  // Displays a message on the screen.
+  // Queues a message for the screen.
   cmdDispatchers["message"] = [this](const Json::Value& payload) {
-    if (payload.isMember("message")) {
-      serverMessage = payload["message"].asString();
-      startWindowThread(4);
-    }
+    if (payload.isMember("message") && machine.messages.push(payload)) showMessages();
   };
 
   // Rotate authorization token.
@@ -65,73 +169,411 @@ void WebSocket::initDispatchers()
     }
   };
 
+  // Updates the leaderboard, optionally showing it.
+  cmdDispatchers["leaderboard"] = [this](const Json::Value& payload) {
+    // Deltas can't apply until the snapshot being fetched arrives.
+    const bool waiting = !payload.isMember("snapshot") && syncingLeaderboard(leaderboardSync.load());
+    if (!waiting && !machine.leaderboard.apply(payload)) syncLeaderboard();
+
+    // Queued like a message without text, so it doesn't cut one short.
+    if (payload["show"].asBool()) {
+      Json::Value msg;
+      msg["id"] = "leaderboard";
+      msg["message"] = "";
+      if (machine.messages.push(msg)) showMessages();
+    }
+  };
+
+  // Replaces the backend URLs, e.g. to move cabinets to a regional relay.
+  cmdDispatchers["endpoints"] = [this](const Json::Value& payload) {
+    Json::Value list(Json::arrayValue);
+    vector<string> urls;
+
+    // Plain ws:// is left to -w for development; the server can't
+    // move cabinets onto an unencrypted connection.
+    for (const auto& url : payload["endpoints"]) {
+      if (!url.isString()) continue;
+      const string u = url.asString();
+      if (u.compare(0, 6, "wss://") == 0) {
+        urls.push_back(u);
+        list.append(u);
+      }
+      else {
+        LOG_WARNING << "Ignoring endpoint " << u << ": not wss://";
+      }
+    }
+
+    if (urls.empty()) return;
+
+    Json::Value config;
+    config["endpoints"] = list;
+    machine.config.save(config);
+    machine.config.endpoints = urls;
+
+    endpoints.set(urls);
+    checkEndpoints();
+  };
+
+  // Writes a trace of recent events to the tmp path.
+  cmdDispatchers["trace_dump"] = [this](const Json::Value&) {
+    Trace::dump(machine.game->getTmpPath());
+  };
+
   // todo: Sign and verify payload signatures.
 }
 
-void WebSocket::setHeaders()
+/**
+ * Opens the message window, now and when the next scheduled message is
+ * due. The window shows queued messages until none are left.
+ */
+void WebSocket::showMessages()
+{
+  machine.show(4);
+
+  MessageQueue::Clock::time_point when;
+  if (!machine.messages.scheduled(when)) return;
+
+  // One wake-up at a time; a new timer only when it moves earlier.
+  const int64_t at = when.time_since_epoch().count();
+  int64_t wake = messageWake.load();
+  do {
+    if (wake != 0 && wake <= at) return;
+  } while (!messageWake.compare_exchange_weak(wake, at));
+
+  executor.schedule(when - MessageQueue::Clock::now(), [this, at]() {
+    // Superseded by an earlier wake-up.
+    int64_t expected = at;
+    if (messageWake.compare_exchange_strong(expected, 0)) showMessages();
+  });
+}
+
+/**
+ * Fetches a leaderboard snapshot after a missed delta, unless one is
+ * already on its way. A request that went unanswered is retried after
+ * WS_LEADERBOARD_SYNC_TIMEOUT.
+ */
+void WebSocket::syncLeaderboard()
+{
+  const int64_t now = Metrics::Clock::now().time_since_epoch().count();
+
+  int64_t since = leaderboardSync.load();
+  do {
+    if (syncingLeaderboard(since)) return;
+  } while (!leaderboardSync.compare_exchange_weak(since, now));
+
+  send({"/api/v1/leaderboard", "GET"}, [this](const Response& response) {
+    leaderboardSync.store(0);
+
+    if (response.status != 200) {
+      LOG_ERROR << "Failed to fetch leaderboard.";
+      return;
+    }
+
+    Json::Value body;
+    Json::Reader().parse(response.body, body);
+    machine.leaderboard.apply(body["message"]);
+  });
+}
+
+/**
+ * Whether a snapshot requested at since (clock ticks) may still arrive.
+ */
+bool WebSocket::syncingLeaderboard(int64_t since)
+{
+  const auto timeout = chrono::duration_cast<Metrics::Clock::duration>(
+    chrono::seconds(WS_LEADERBOARD_SYNC_TIMEOUT));
+  return since != 0 && Metrics::Clock::now().time_since_epoch().count() - since < timeout.count();
+}
+
+ix::WebSocketHttpHeaders WebSocket::headers(const string& url) const
 {
   ix::WebSocketHttpHeaders headers;
   headers["Content-Type"] = "application/json; charset=utf-8";
+  headers[WS_ENCODING_HEADER] = WS_ENCODING_CBOR;
+
+  const Config& config = machine.config;
+  if (!config.machineId.empty() && !config.token.empty()) {
+    headers["Authorization"] = "Bearer " + config.token;
+    headers["X-Machine-Uuid"] = config.machineId;
+  }
 
-  if (!Config::machineId.empty() && !Config::token.empty()) {
-    headers["Authorization"] = "Bearer " + Config::token;
-    headers["X-Machine-Uuid"] = Config::machineId;
+  // Only the gateway gets its secret, not endpoints failed over to.
+  if (!config.gatewaySecret.empty() && url == config.gatewayUrl) {
+    headers["X-Gateway-Secret"] = config.gatewaySecret;
   }
 
-  ws.setExtraHeaders(headers);
+  return headers;
 }
 
 void WebSocket::rotateToken(const Json::Value& config)
 {
-  cout << "Updating token." << endl;
-  Config::save(config);
-  thread([this]() {
-    this_thread::sleep_for(chrono::milliseconds(100));
-    reconnect();
-  })
-  .detach();
+  LOG_INFO << "Updating token.";
+  machine.config.save(config);
+  reconnect(socket()->getUrl());
 }
 
-void WebSocket::reconnect()
+/**
+ * Replaces the connection, make-before-break: a new socket with the
+ * current credentials is opened alongside the old one, and only once
+ * it's up does it take over. The old socket is closed after a grace
+ * period for responses still on their way. If the new one can't
+ * connect, the old one carries on.
+ */
+void WebSocket::reconnect(const string& url)
 {
-  ws.stop();
-  Config::load();
-  setHeaders();
-  connect();
+  reconnects.inc();
+  loadConfig();
+
+  auto sock = makeSocket(url);
+  shared_ptr<ix::WebSocket> abandoned;
+  {
+    lock_guard<mutex> lock(replacementMtx);
+    abandoned = move(replacement);
+    replacement = sock;
+    replacementOpen = false;
+    replacementError.clear();
+  }
+
+  // Stopping waits for the socket's callback, which takes the lock.
+  if (abandoned) abandoned->stop();
+
+  handshakeStart.store(Metrics::Clock::now().time_since_epoch().count());
+  sock->start();
+
+  const auto deadline = Executor::Clock::now() + chrono::seconds(WS_CONNECT_TIMEOUT);
+  executor.schedule(chrono::milliseconds(50), [this, deadline]() { promote(deadline); });
 }
 
-void WebSocket::setupCallbacks()
+/**
+ * Switches to the replacement socket once it's open.
+ */
+void WebSocket::promote(Executor::Clock::time_point deadline)
 {
-  ws.setOnMessageCallback([this](const ix::WebSocketMessagePtr& msg) {
+  shared_ptr<ix::WebSocket> sock;
+  ix::WebSocketHttpHeaders openHeaders;
+  bool opened;
+  {
+    lock_guard<mutex> lock(replacementMtx);
+    if (!replacement) return;
+
+    opened = replacementOpen;
+    if (!opened) {
+      if (replacementError.empty() && Executor::Clock::now() < deadline) {
+        executor.schedule(chrono::milliseconds(50), [this, deadline]() { promote(deadline); });
+        return;
+      }
+
+      LOG_ERROR << "Replacement connection failed: "
+                << (replacementError.empty() ? "timeout." : replacementError);
+    }
+
+    sock = move(replacement);
+    openHeaders = replacementHeaders;
+  }
+
+  if (!opened) {
+    endpoints.failed(sock->getUrl());
+    sock->stop();
+    return;
+  }
+
+  shared_ptr<ix::WebSocket> old = socket();
+  setSocket(sock);
+  onOpen(openHeaders);
+  LOG_INFO << "Switched to new connection.";
+
+  executor.schedule(chrono::seconds(WS_ROTATE_GRACE), [old]() { old->stop(); });
+}
+
+/**
+ * Moves to the best healthy endpoint after the current one failed.
+ */
+void WebSocket::failover()
+{
+  const string current = socket()->getUrl();
+  if (endpoints.healthy(current) || replacing()) return;
+
+  for (const auto& url : endpoints.ranked()) {
+    if (!endpoints.healthy(url)) break;
+    if (url == current) continue;
+
+    LOG_INFO << "Failing over to " << url;
+    failovers.inc();
+    reconnect(url);
+    return;
+  }
+}
+
+/**
+ * Probes the endpoints in the background and then moves to a markedly
+ * faster one, which is also how a recovered endpoint is failed back to.
+ */
+void WebSocket::checkEndpoints()
+{
+  if (endpoints.size() < 2 || replacing() || probing.exchange(true)) return;
+
+  // Probing takes up to a second; keep it off the executor and hand
+  // only the outcome back.
+  if (prober.joinable()) prober.join();
+  prober = thread([this]() {
+    endpoints.probe();
+    executor.post([this]() {
+      probing.store(false);
+      switchEndpoint();
+    });
+  });
+}
+
+/**
+ * Moves to the best endpoint from the last probe if it's markedly
+ * faster than the current one, or the current one is down.
+ */
+void WebSocket::switchEndpoint()
+{
+  if (replacing()) return;
+
+  const string current = socket()->getUrl();
+  const string best = endpoints.ranked().front();
+  if (best == current || !endpoints.healthy(best)) return;
+
+  const double rttBest = endpoints.rtt(best), rttCurrent = endpoints.rtt(current);
+  if (connected.load() && endpoints.healthy(current) && rttCurrent >= 0 &&
+      rttBest > rttCurrent * WS_FAILBACK_RATIO) {
+    return;
+  }
+
+  LOG_INFO << "Switching to " << best;
+  reconnect(best);
+}
+
+void WebSocket::scheduleProbe()
+{
+  executor.schedule(chrono::seconds(WS_PROBE_INTERVAL), [this]() {
+    checkEndpoints();
+    scheduleProbe();
+  });
+}
+
+void WebSocket::onOpen(const ix::WebSocketHttpHeaders& openHeaders)
+{
+  auto it = openHeaders.find(WS_ENCODING_HEADER);
+  binary.store(it != openHeaders.end() && it->second == WS_ENCODING_CBOR);
+
+  // The server may decline compression.
+  it = openHeaders.find("Sec-WebSocket-Extensions");
+  deflate.store(it != openHeaders.end() && it->second.find("permessage-deflate") != string::npos);
+
+  const int64_t start = handshakeStart.exchange(0);
+  if (start != 0) {
+    handshake.observe(Metrics::Clock::now() - Metrics::Clock::time_point(Metrics::Clock::duration(start)));
+  }
+
+  endpoints.succeeded(socket()->getUrl());
+
+  connected.store(true);
+  connects.inc();
+
+  {
+    lock_guard<mutex> lock(outboxMtx);
+    if (outbox.size() > 0) LOG_INFO << "Sending " << outbox.size() << " queued message(s).";
+  }
+
+  flushOutbox();
+  startHeartbeat();
+}
+
+void WebSocket::setupCallbacks(ix::WebSocket& sock)
+{
+  ix::WebSocket* self = &sock;
+
+  sock.setOnMessageCallback([this, self](const ix::WebSocketMessagePtr& msg) {
+    // Connection events from a replacement still warming up, or from an
+    // old socket winding down, don't affect the active connection.
+    if (self != active.load() && msg->type != ix::WebSocketMessageType::Message) {
+      lock_guard<mutex> lock(replacementMtx);
+      if (self != replacement.get()) return;
+
+      if (msg->type == ix::WebSocketMessageType::Open) {
+        replacementHeaders = msg->openInfo.headers;
+        replacementOpen = true;
+      }
+      else if (msg->type == ix::WebSocketMessageType::Error) {
+        replacementError = msg->errorInfo.reason.empty() ? "Connection failed." : msg->errorInfo.reason;
+      }
+      else if (msg->type == ix::WebSocketMessageType::Close && !replacementOpen) {
+        replacementError = "Connection closed.";
+      }
+      return;
+    }
+
     switch (msg->type) {
-    case ix::WebSocketMessageType::Error:
+    case ix::WebSocketMessageType::Error: {
       lastError = msg->errorInfo.reason.empty() ? "Connection failed." : msg->errorInfo.reason;
+
+      // The socket retries on its own; once the endpoint has failed too
+      // often, move elsewhere.
+      const string url = self->getUrl();
+      endpoints.failed(url);
+      if (started.load() && !endpoints.healthy(url)) executor.post([this]() { failover(); });
       break;
+    }
 
     case ix::WebSocketMessageType::Open:
-      connected.store(true);
-      if (!Config::machineId.empty() && !Config::token.empty()) startPing();
+      onOpen(msg->openInfo.headers);
       break;
 
     case ix::WebSocketMessageType::Close:
       connected.store(false);
-      stopPing();
+      disconnects.inc();
+      chooseCompression();
       if (msg->closeInfo.code == 4001) lastError = "Authentication failed.";
       break;
 
     case ix::WebSocketMessageType::Message: {
+      Envelope env;
       Json::Value json;
-      if (!Json::Reader().parse(msg->str, json)) break;
+
+      // JSON is only scanned for the fields that route it; the whole
+      // message is parsed later, and only if its handler needs it.
+      if (msg->binary) {
+        if (!decodeCbor(msg->str, json)) break;
+        env.from(json);
+      }
+      else if (!env.scan(msg->str)) {
+        break;
+      }
+
+      auto whole = [&]() -> const Json::Value& {
+        if (json.isNull()) Json::Reader().parse(msg->str, json);
+        return json;
+      };
 
       // API response.
-      if (json.isMember("request_id")) {
-        if (validateApiResponse(json) == 0) processApiResponse(json);
+      if (!env.requestId.empty()) {
+        int rc = validateApiResponse(env.requestId);
+        if (rc == 0) {
+          processApiResponse(env, msg->str.size(), msg->wireSize);
+        }
+        else if (rc == 2) {
+          countBytes(false, "relay", msg->str.size(), msg->wireSize);
+          dispatchRelay(whole());
+        }
         break;
       }
 
       // Server command.
-      if (json.isMember("uuid") && json["uuid"].asString() == Config::machineId) {
-        processCmd(json);
+      if (env.uuid.empty()) break;
+
+      if (env.uuid == *atomic_load(&machineId)) {
+        countBytes(false, "command", msg->str.size(), msg->wireSize);
+        whole();
+        executor.post([this, cmd = move(env.cmd), payload = move(json)]() {
+          processCmd(cmd, payload);
+        });
+      }
+      else if (hasRelayHandler()) {
+        countBytes(false, "relay", msg->str.size(), msg->wireSize);
+        dispatchRelay(whole());
       }
       break;
     }
@@ -140,6 +582,7 @@ void WebSocket::setupCallbacks()
       break;
 
     case ix::WebSocketMessageType::Pong:
+      onPong(msg->str);
       break;
 
     case ix::WebSocketMessageType::Fragment:
@@ -148,119 +591,444 @@ void WebSocket::setupCallbacks()
   });
 }
 
-void WebSocket::processApiResponse(const Json::Value& json)
+/**
+ * Hands a response to its callback on the executor, so the callback's
+ * disk or X work doesn't hold up the network thread.
+ */
+void WebSocket::processApiResponse(Envelope& env, size_t payloadSize, size_t wireSize)
 {
-  lock_guard<mutex> lock(callbacksMtx);
-  auto it = callbacks.find(json["request_id"].asString());
-  if (it != callbacks.end()) {
-    it->second(json);
+  Pending req;
+  {
+    lock_guard<mutex> lock(callbacksMtx);
+    auto it = callbacks.find(env.requestId);
+    if (it == callbacks.end()) return;
+
+    req = move(it->second);
     callbacks.erase(it);
+    pending.sub();
   }
+
+  const auto now = Metrics::Clock::now();
+
+  countBytes(false, req.path.c_str(), payloadSize, wireSize);
+
+  countResponse(req.path, env.status, now - req.sent);
+
+  Trace::record("server", req.traceId, req.sent, now);
+
+  executor.post([req = move(req), response = Response{env.status, move(env.body)}]() {
+    Trace::Scope scope(req.traceId);
+    Trace::Span span("callback");
+    req.callback(response);
+  });
 }
 
-void WebSocket::processCmd(const Json::Value& payload)
+void WebSocket::processCmd(const string& cmd, const Json::Value& payload)
 {
-  const string& cmd = payload["cmd"].asString();
   auto it = cmdDispatchers.find(cmd);
   if (it != cmdDispatchers.end()) {
     it->second(payload);
   }
   else {
-    cerr << "Unknown command: " << cmd << endl;
+    LOG_ERROR << "Unknown command: " << cmd;
   }
 }
 
-int WebSocket::validateApiResponse(const Json::Value& response)
+bool WebSocket::decodeCbor(const string& frame, Json::Value& json)
+{
+  // A binary frame means the server speaks CBOR, even if its handshake
+  // didn't say so.
+  if (!binary.exchange(true)) LOG_INFO << "Server supports CBOR, switching.";
+
+  if (!Cbor::decode(frame, json)) {
+    LOG_ERROR << "Invalid CBOR frame.";
+    return false;
+  }
+
+  return true;
+}
+
+int WebSocket::validateApiResponse(const string& request_id)
 {
-  string request_id = response["request_id"].asString();
   uuid_t uuid;
 
-  if (request_id.empty() ||
-      uuid_parse(request_id.c_str(), uuid) != 0 ||
-      callbacks.find(request_id) == callbacks.end()) {
+  if (request_id.empty() || uuid_parse(request_id.c_str(), uuid) != 0) {
+    LOG_ERROR << "Missing or invalid request id.";
+    return 1;
+  }
+
+  bool known;
+  {
+    lock_guard<mutex> lock(callbacksMtx);
+    known = callbacks.find(request_id) != callbacks.end();
+  }
+
+  if (!known) {
+    // Another machine's request, relayed through this one.
+    if (hasRelayHandler()) return 2;
 
-    cerr << "Error: Missing or invalid request id." << endl;
+    LOG_ERROR << "Missing or invalid request id.";
     return 1;
   }
 
   return 0;
 }
 
+void WebSocket::setRelayHandler(Handler handler)
+{
+  lock_guard<mutex> lock(relayMtx);
+  relayHandler = move(handler);
+}
+
+bool WebSocket::hasRelayHandler()
+{
+  lock_guard<mutex> lock(relayMtx);
+  return relayHandler != nullptr;
+}
+
+void WebSocket::dispatchRelay(const Json::Value& json)
+{
+  lock_guard<mutex> lock(relayMtx);
+  if (relayHandler) relayHandler(json);
+}
+
+/**
+ * Connects to the best endpoint, trying each in turn until one opens.
+ */
 void WebSocket::connect()
 {
-  connected.store(false);
-  lastError.clear();
-  ws.start();
-
-  auto timeout = chrono::steady_clock::now() + chrono::seconds(10);
-  while (chrono::steady_clock::now() < timeout) {
-    if (connected.load()) return;
-    if (!lastError.empty()) break;
-    this_thread::sleep_for(chrono::milliseconds(50));
-  }
+  if (endpoints.size() > 1) endpoints.probe();
+
+  string error;
+
+  for (const auto& url : endpoints.ranked()) {
+    if (url != socket()->getUrl()) setSocket(makeSocket(url));
+
+    connected.store(false);
+    lastError.clear();
+    handshakeStart.store(Metrics::Clock::now().time_since_epoch().count());
+    socket()->start();
+
+    auto timeout = chrono::steady_clock::now() + chrono::seconds(WS_CONNECT_TIMEOUT);
+    while (chrono::steady_clock::now() < timeout) {
+      if (connected.load()) break;
+      if (!lastError.empty()) break;
+      this_thread::sleep_for(chrono::milliseconds(50));
+    }
 
-  if (!connected.load()) {
-    string error = lastError.empty() ? "timeout or unknown error." : lastError;
-    throw runtime_error("Socket failed to connect: " + error);
+    if (connected.load()) {
+      if (!started.exchange(true)) scheduleProbe();
+      return;
+    }
+
+    error = lastError.empty() ? "timeout or unknown error." : lastError;
+    LOG_ERROR << "Failed to connect to " << url << ": " << error;
+    socket()->stop();
   }
+
+  throw runtime_error("Socket failed to connect: " + error);
 }
 
-void WebSocket::send(const Json::Value& msg, Callback callback)
+void WebSocket::send(const Request& req, Callback callback)
 {
-  if (!connected.load()) return;
+  const bool upload = isUpload(req.path);
+  if (!connected.load() && !upload) return;
 
-  Json::Value sendmsg = msg;
-  sendmsg["version"] = Version::FULL;
+  char reqid[37] = "";
 
   if (callback) {
     uuid_t uuid;
-    string reqid(37, '\0');
-
     uuid_generate_random(uuid);
-    uuid_unparse_lower(uuid, &reqid[0]);
-    reqid.resize(36);
-    sendmsg["request_id"] = reqid;
+    uuid_unparse_lower(uuid, reqid);
 
     lock_guard<mutex> lock(callbacksMtx);
-    callbacks[reqid] = callback;
+    callbacks[reqid] = {callback, req.path, Metrics::Clock::now(), Trace::current()};
+    pending.add();
+  }
+
+  lock_guard<mutex> lock(writerMtx);
+  {
+    Trace::Span span("serialize");
+    writer.setBinary(binary.load());
+    writer.begin(3 + !req.query.empty() + (req.body != nullptr) + (callback != nullptr));
+    writer.field("path", req.path);
+    writer.field("method", req.method);
+    if (!req.query.empty()) writer.field("query", req.query);
+    if (req.body) writer.field("body", *req.body);
+    writer.field("version", Version::FULL);
+    if (callback) writer.field("request_id", reqid);
+    writer.end();
+  }
+
+  transmit(reqid, req.path, upload);
+}
+
+bool WebSocket::relay(const Json::Value& msg)
+{
+  lock_guard<mutex> lock(writerMtx);
+  {
+    Trace::Span span("serialize");
+    writer.setBinary(binary.load());
+    writer.write(msg);
   }
 
-  Json::StreamWriterBuilder writerBuilder;
-  writerBuilder["indentation"] = "";
-  ws.send(Json::writeString(writerBuilder, sendmsg));
+  const string path = msg["path"].asString();
+  return transmit(msg["request_id"].asString().c_str(), path.c_str(), isUpload(path.c_str()));
 }
 
-void WebSocket::startPing()
+/**
+ * Sends the message in the writer, or queues it in its lane if the
+ * lane's rate limit or an outage holds it back; only uploads are kept
+ * through an outage. A lane stays in order: while it holds messages,
+ * new ones queue behind. Called with writerMtx held.
+ */
+bool WebSocket::transmit(const char* reqid, const char* path, bool upload)
 {
-  if (pingThreadRunning.exchange(true)) return;
+  Trace::Span span("ws_send");
+  const string& payload = writer.str();
+  const bool bin = writer.isBinary();
+  const Lanes::Lane lane = Lanes::classify(path);
 
-  pingThread = std::thread([this]() {
-    Json::Value req;
-    req["path"] = "/api/v1/ping";
-    req["method"] = "POST";
+  lock_guard<mutex> lock(outboxMtx);
 
-    while (pingThreadRunning.load() && connected.load()) {
-      this->send(req, [this](const Json::Value& response) {
-        if (response["status"].asInt() != 200) {
-          cerr << "Ping failed." << endl;
-        }
-      });
+  if (!connected.load() && !upload) return false;
 
-      {
-        unique_lock<std::mutex> lock(pingMtx);
-        pingCv.wait_for(lock, chrono::seconds(10), [this]() {
-          return !pingThreadRunning.load() || !connected.load();
-        });
+  if (connected.load() && outbox.empty(lane)) {
+    if (outbox.take(lane)) {
+      ix::WebSocketSendInfo info = socket()->send(payload, bin);
+      if (info.success) {
+        countBytes(true, path, info.payloadSize, info.wireSize);
+        return true;
       }
     }
+    else {
+      throttled[lane]->inc();
+    }
+  }
+
+  Lanes::Message old;
+  if (outbox.push(lane, {reqid, path, payload, bin}, old)) {
+    queued.add();
+  }
+  else {
+    LOG_WARNING << "Outbox full, dropping oldest " << Lanes::name(lane) << " message.";
+    lock_guard<mutex> cbLock(callbacksMtx);
+    if (callbacks.erase(old.reqid)) pending.sub();
+    dropped.inc();
+  }
+
+  scheduleDrain();
+  return true;
+}
+
+/**
+ * Sends queued messages as their lanes' rate limits allow, sharing the
+ * connection between lanes by weight.
+ */
+void WebSocket::flushOutbox()
+{
+  lock_guard<mutex> lock(outboxMtx);
+  shared_ptr<ix::WebSocket> sock = socket();
+  Lanes::Lane lane;
+
+  while (connected.load()) {
+    const Lanes::Message* msg = outbox.next(lane);
+    if (!msg) break;
+
+    ix::WebSocketSendInfo info = sock->send(msg->payload, msg->binary);
+    if (!info.success) break;
+
+    countBytes(true, msg->path.c_str(), info.payloadSize, info.wireSize);
+    outbox.pop(lane);
+    queued.sub();
+  }
+
+  scheduleDrain();
+}
+
+/**
+ * Flushes the outbox once the next queued message may go. Called with
+ * outboxMtx held.
+ */
+void WebSocket::scheduleDrain()
+{
+  if (!connected.load() || outbox.size() == 0 || drainScheduled.exchange(true)) return;
+
+  executor.schedule(outbox.wait(), [this]() {
+    drainScheduled.store(false);
+    flushOutbox();
   });
 }
 
-void WebSocket::stopPing()
+void WebSocket::countBytes(bool sent, const char* path, size_t payloadSize, size_t wireSize)
 {
-  pingThreadRunning.store(false);
-  pingCv.notify_one();
-  if (pingThread.joinable() && pingThread.get_id() != this_thread::get_id()) pingThread.join();
+  Metrics::Counter** c;
+  {
+    lock_guard<mutex> lock(bytesMtx);
+    auto it = byteCounters.find(path);
+
+    if (it == byteCounters.end()) {
+      ByteCounters& bc = byteCounters[path];
+      const char* directions[] = {"received", "sent"};
+      const char* stages[] = {"payload", "wire"};
+
+      for (int d = 0; d < 2; d++) {
+        for (int st = 0; st < 2; st++) {
+          bc[d * 2 + st] = &Metrics::counter("ssbd_ws_bytes_total", bytesHelp,
+            {{"direction", directions[d]}, {"path", path}, {"stage", stages[st]}});
+        }
+      }
+
+      it = byteCounters.find(path);
+    }
+
+    c = it->second.data() + (sent ? 2 : 0);
+  }
+
+  c[0]->inc(payloadSize);
+  c[1]->inc(wireSize);
+
+  session.messages.fetch_add(1, memory_order_relaxed);
+  session.payload.fetch_add(payloadSize, memory_order_relaxed);
+  session.wire.fetch_add(wireSize, memory_order_relaxed);
+}
+
+/**
+ * Records a response against its path's metrics, registering them the
+ * first time a path or status is seen.
+ */
+void WebSocket::countResponse(const string& path, int status, Metrics::Clock::duration rtt)
+{
+  Metrics::Histogram* seconds;
+  Metrics::Counter* responses;
+  {
+    lock_guard<mutex> lock(bytesMtx);
+    RequestMetrics& rm = requestMetrics[path];
+
+    if (!rm.seconds) {
+      rm.seconds = &Metrics::histogram(
+        "ssbd_request_seconds", "Round trip time of API requests.", {{"path", path}});
+    }
+
+    Metrics::Counter*& c = rm.responses[status];
+    if (!c) {
+      c = &Metrics::counter(
+        "ssbd_responses_total", "API responses received.",
+        {{"path", path}, {"status", to_string(status)}});
+    }
+
+    seconds = rm.seconds;
+    responses = c;
+  }
+
+  seconds->observe(rtt);
+  responses->inc();
+}
+
+void WebSocket::setCompression(int bits)
+{
+  windowBits = bits;
+  deflateWorthwhile = true;
+  requestCompression(bits > 0);
+}
+
+void WebSocket::requestCompression(bool enable)
+{
+  deflateRequested = enable && windowBits > 0;
+  if (auto sock = socket()) sock->setPerMessageDeflateOptions(deflateOptions());
+}
+
+ix::WebSocketPerMessageDeflateOptions WebSocket::deflateOptions() const
+{
+  const uint8_t bits = static_cast<uint8_t>(deflateRequested ? windowBits : WS_DEFLATE_WINDOW_BITS);
+  return ix::WebSocketPerMessageDeflateOptions(deflateRequested, false, false, bits, bits);
+}
+
+/**
+ * Decides, as a session ends, whether the next one is compressed.
+ *
+ * ix compresses every message or none, so rather than skipping small
+ * messages, sessions whose messages are small on average go without.
+ */
+void WebSocket::chooseCompression()
+{
+  const uint64_t messages = session.messages.exchange(0);
+  const uint64_t payload = session.payload.exchange(0);
+  const uint64_t wire = session.wire.exchange(0);
+
+  if (windowBits == 0 || messages < WS_DEFLATE_SAMPLE) return;
+
+  if (deflate.load() && static_cast<double>(wire) > static_cast<double>(payload) * WS_DEFLATE_MAX_RATIO) {
+    if (deflateWorthwhile) LOG_INFO << "Compression saves little, disabling it.";
+    deflateWorthwhile = false;
+  }
+
+  const bool enable = deflateWorthwhile && payload / messages >= WS_DEFLATE_MIN_BYTES;
+  if (enable != deflateRequested) {
+    LOG_DEBUG << "Compression " << (enable ? "enabled" : "disabled") << " for the next session.";
+    requestCompression(enable);
+  }
+}
+
+/**
+ * Starts pinging for a new connection. Pings from an earlier one stop
+ * when they see the generation has moved on.
+ */
+void WebSocket::startHeartbeat()
+{
+  const uint64_t gen = ++heartbeatGen;
+  pingSent.store(0);
+  pingInterval = WS_PING_MIN;
+
+  executor.schedule(chrono::seconds(WS_PING_MIN), [this, gen]() { heartbeat(gen); });
+}
+
+/**
+ * Sends a ping and checks for its pong WS_PONG_TIMEOUT later.
+ */
+void WebSocket::heartbeat(uint64_t gen)
+{
+  if (gen != heartbeatGen.load() || !connected.load()) return;
+
+  // Tighten while players are logged in, back off while idle.
+  if (machine.playerList.count() > 0) pingInterval = WS_PING_MIN;
+  else pingInterval = min(pingInterval.load() * 2, WS_PING_MAX);
+
+  const uint64_t seq = ++pingSeq;
+  pingSent.store(Metrics::Clock::now().time_since_epoch().count());
+  socket()->ping(to_string(seq));
+
+  executor.schedule(chrono::seconds(WS_PONG_TIMEOUT), [this, gen]() { checkPong(gen); });
+}
+
+/**
+ * A missing pong means the server, or the path to it, is gone. Closing
+ * the connection has ix reconnect.
+ */
+void WebSocket::checkPong(uint64_t gen)
+{
+  if (gen != heartbeatGen.load() || !connected.load()) return;
+
+  if (pingSent.exchange(0) != 0) {
+    LOG_WARNING << "No pong from server in " << WS_PONG_TIMEOUT << "s, reconnecting.";
+    heartbeatTimeouts.inc();
+    socket()->close(1011, "Heartbeat timeout");
+    return;
+  }
+
+  executor.schedule(chrono::seconds(pingInterval - WS_PONG_TIMEOUT), [this, gen]() { heartbeat(gen); });
+}
+
+/**
+ * Called on the network thread when a pong arrives.
+ */
+void WebSocket::onPong(const string& payload)
+{
+  const int64_t sent = pingSent.load();
+  if (sent == 0 || payload != to_string(pingSeq.load())) return;
+
+  rtt.observe(Metrics::Clock::now() - Metrics::Clock::time_point(Metrics::Clock::duration(sent)));
+  pingSent.store(0);
 }
 
 // vim: set ts=2 sw=2 expandtab:
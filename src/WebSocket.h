@@ -17,44 +17,269 @@
 
 #pragma once
 
+#include <array>
+#include <memory>
+#include <thread>
+
 #include <ixwebsocket/IXWebSocket.h>
 #include <json/json.h>
 
+#include "Endpoints.h"
+#include "Executor.h"
+#include "Lanes.h"
+#include "Metrics.h"
+#include "RequestWriter.h"
+
+// Advertises the binary (CBOR) wire format; a server that supports it
+// echoes the header or sends any binary frame, and JSON is used until then.
+#define WS_ENCODING_HEADER "X-Ssbd-Encoding"
+#define WS_ENCODING_CBOR "cbor"
+
+// Heartbeat: seconds between pings, from while players are logged in
+// (and just after connecting) up to fully idle, and the wait for a pong
+// before the connection is treated as dead.
+#define WS_PING_MIN 15
+#define WS_PING_MAX 120
+#define WS_PONG_TIMEOUT 10
+
+// Seconds to wait for a connection to open, and for responses still in
+// flight on a replaced connection before it's closed.
+#define WS_CONNECT_TIMEOUT 10
+#define WS_ROTATE_GRACE 5
+
+// Seconds to wait for a leaderboard snapshot before asking again.
+#define WS_LEADERBOARD_SYNC_TIMEOUT 30
+
+// Seconds between endpoint probes, and how much faster (as a fraction
+// of the current round trip time) another endpoint must be to move to it.
+#define WS_PROBE_INTERVAL 300
+#define WS_FAILBACK_RATIO 0.7
+
+// permessage-deflate window size, 8-15; larger compresses better but
+// costs the server more memory per connection.
+#define WS_DEFLATE_WINDOW_BITS 15
+
+// Messages a session needs before its sizes decide the next session's
+// compression, and the average size below which compression is skipped.
+#define WS_DEFLATE_SAMPLE 20
+#define WS_DEFLATE_MIN_BYTES 256
+
+// Compression that doesn't get messages below this fraction of their
+// size is turned off for good.
+#define WS_DEFLATE_MAX_RATIO 0.8
+
+struct Envelope;
+struct Machine;
+
 class WebSocket
 {
 public:
-  typedef std::function<void(const Json::Value&)> Callback;
+  // A response to a request. The body is usually JSON text.
+  struct Response {
+    int status;
+    std::string body;
+  };
+
+  typedef std::function<void(const Response&)> Callback;
+
+  // Receives whole messages: server commands and relayed traffic.
+  typedef std::function<void(const Json::Value&)> Handler;
+
+  // A request to the backend. The body is serialized where it is, not
+  // copied.
+  struct Request {
+    const char* path;
+    const char* method;
+    const Json::Value* body;
+    std::string query;
+
+    Request(const char* p, const char* m, const Json::Value* b = nullptr, std::string q = "") :
+      path(p), method(m), body(b), query(std::move(q)) {}
+  };
 
-  WebSocket(const std::string& uri);
+  /**
+   * @param uris Backend URLs, in order of preference; the fastest
+   *             healthy one is used.
+   * @param m The machine this connection serves; its config supplies
+   *          the credentials and server commands act on it.
+   */
+  WebSocket(const std::vector<std::string>& uris, Machine& m);
   ~WebSocket();
 
   void connect();
-  void send(const Json::Value& msg, Callback callback = nullptr);
+  void stop();
+  void send(const Request& req, Callback callback = nullptr);
+
+  /**
+   * @brief Sends a request on behalf of another machine.
+   *
+   * The request keeps its own request_id, and its response goes to the
+   * relay handler. Uploads are queued while the server is unreachable.
+   *
+   * @return False if the request could be neither sent nor queued.
+   */
+  bool relay(const Json::Value& msg);
+
+  /**
+   * @brief Receives responses and server commands meant for other
+   *        machines, i.e. those relayed through this one.
+   *
+   * The handler runs on the network thread. Replacing it waits for a
+   * call in progress, so once cleared its owner can go.
+   */
+  void setRelayHandler(Handler handler);
+
+  bool isConnected() const { return connected.load(); }
+
+  /**
+   * @brief Sets the permessage-deflate window size, or disables
+   *        compression with 0. Takes effect from the next connection.
+   */
+  void setCompression(int windowBits);
 
 private:
-  std::string baseUri;
-  ix::WebSocket ws;
+  // A request awaiting its response.
+  struct Pending {
+    Callback callback;
+    std::string path;
+    Metrics::Clock::time_point sent;
+    uint64_t traceId;
+  };
+
+  // ssbd_ws_bytes_total counters for a path: received payload and wire,
+  // then sent payload and wire.
+  typedef std::array<Metrics::Counter*, 4> ByteCounters;
+
+  // Request metrics for a path: round trip time, and responses by status.
+  struct RequestMetrics {
+    Metrics::Histogram* seconds = nullptr;
+    std::map<int, Metrics::Counter*> responses;
+  };
+
+  // Message bytes this session, before and after compression.
+  struct Session {
+    std::atomic<uint64_t> messages{0};
+    std::atomic<uint64_t> payload{0};
+    std::atomic<uint64_t> wire{0};
+  };
+
+  Endpoints endpoints;
+  Machine& machine;
+
+  // The machine's UUID as of the last config load, for the network
+  // thread to route commands by; the config itself is reloaded on the
+  // executor. Use atomic_load/atomic_store.
+  std::shared_ptr<const std::string> machineId;
+
+  // The active socket, swapped whole when the connection is replaced;
+  // use socket() to read it. The raw pointer tells its events apart.
+  std::shared_ptr<ix::WebSocket> ws;
+  std::atomic<ix::WebSocket*> active{nullptr};
+
+  // A connection being opened to replace the active one.
+  std::shared_ptr<ix::WebSocket> replacement;
+  ix::WebSocketHttpHeaders replacementHeaders;
+  bool replacementOpen = false;
+  std::string replacementError;
+  std::mutex replacementMtx;
+
+  // Clock ticks when the pending connection was started, or 0.
+  std::atomic<int64_t> handshakeStart{0};
 
   std::atomic<bool> connected{false};
-  std::atomic<bool> pingThreadRunning{false};
 
-  std::thread pingThread;
+  // Set once connect() succeeds; failover is left to connect() until then.
+  std::atomic<bool> started{false};
+
+  // Probes run on their own thread; set until the result is handled.
+  std::atomic<bool> probing{false};
+  std::thread prober;
+
+  // Whether the server accepts CBOR frames.
+  std::atomic<bool> binary{false};
+
+  // Compression: as configured, as requested for the next connection,
+  // and as negotiated for this one.
+  int windowBits = WS_DEFLATE_WINDOW_BITS;
+  bool deflateWorthwhile = true;
+  bool deflateRequested = false;
+  std::atomic<bool> deflate{false};
+  Session session;
+
+  // Heartbeat state. The pong handler on the network thread clears
+  // pingSent (clock ticks when the last ping went, or 0 once answered).
+  std::atomic<uint64_t> heartbeatGen{0};
+  std::atomic<uint64_t> pingSeq{0};
+  std::atomic<int64_t> pingSent{0};
+  std::atomic<int> pingInterval{WS_PING_MIN};
+
+  // Clock ticks when a leaderboard snapshot was requested, or 0 once it
+  // has arrived. Deltas are dropped meanwhile.
+  std::atomic<int64_t> leaderboardSync{0};
+
+  // Clock ticks when the message window is next due to open, or 0.
+  std::atomic<int64_t> messageWake{0};
+
   std::string lastError;
-  std::mutex callbacksMtx, pingMtx;
-  std::map<std::string, Callback> callbacks;
-  std::condition_variable pingCv;
-  std::unordered_map<std::string, Callback> cmdDispatchers;
-
-  void reconnect();
-  void setupCallbacks();
-  void setHeaders();
-  void startPing();
-  void stopPing();
+  std::mutex callbacksMtx, outboxMtx;
+  std::map<std::string, Pending> callbacks;
+
+  // Messages waiting for their lane's rate limit, and uploads waiting
+  // out an outage. Guarded by outboxMtx.
+  Lanes outbox;
+  std::atomic<bool> drainScheduled{false};
+
+  // Outgoing messages are serialized here; its buffer is reused.
+  RequestWriter writer;
+  std::mutex writerMtx, bytesMtx;
+  std::map<std::string, ByteCounters, std::less<>> byteCounters;
+  std::map<std::string, RequestMetrics, std::less<>> requestMetrics;
+
+  // Guards relayHandler, and is held while it runs.
+  std::mutex relayMtx;
+  Handler relayHandler;
+  std::unordered_map<std::string, Handler> cmdDispatchers;
+
+  // Runs response callbacks and server commands off the network thread.
+  Executor executor;
+
+  std::shared_ptr<ix::WebSocket> socket() const { return std::atomic_load(&ws); }
+  std::shared_ptr<ix::WebSocket> makeSocket(const std::string& url);
+  void setSocket(std::shared_ptr<ix::WebSocket> sock);
+  void loadConfig();
+  bool replacing();
+  void reconnect(const std::string& url);
+  void promote(Executor::Clock::time_point deadline);
+  void onOpen(const ix::WebSocketHttpHeaders& openHeaders);
+  void failover();
+  void checkEndpoints();
+  void switchEndpoint();
+  void scheduleProbe();
+  void setupCallbacks(ix::WebSocket& sock);
+  ix::WebSocketHttpHeaders headers(const std::string& url) const;
+  void startHeartbeat();
+  void heartbeat(uint64_t gen);
+  void checkPong(uint64_t gen);
+  void onPong(const std::string& payload);
   void initDispatchers();
-  void processApiResponse(const Json::Value& json);
-  void processCmd(const Json::Value& payload);
+  void processApiResponse(Envelope& env, size_t payloadSize, size_t wireSize);
+  void processCmd(const std::string& cmd, const Json::Value& payload);
+  bool decodeCbor(const std::string& frame, Json::Value& json);
+  bool transmit(const char* reqid, const char* path, bool upload);
+  void flushOutbox();
+  void scheduleDrain();
+  void countBytes(bool sent, const char* path, size_t payloadSize, size_t wireSize);
+  void countResponse(const std::string& path, int status, Metrics::Clock::duration rtt);
+  void requestCompression(bool enable);
+  ix::WebSocketPerMessageDeflateOptions deflateOptions() const;
+  void chooseCompression();
   void rotateToken(const Json::Value& config);
-  int validateApiResponse(const Json::Value& response);
+  void syncLeaderboard();
+  static bool syncingLeaderboard(int64_t since);
+  void showMessages();
+  int validateApiResponse(const std::string& request_id);
+  bool hasRelayHandler();
+  void dispatchRelay(const Json::Value& json);
 };
 
 // vim: set ts=2 sw=2 expandtab:
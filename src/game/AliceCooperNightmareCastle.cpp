@@ -15,13 +15,13 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
-#include <iostream>
 #include <fstream>
 #include <stdexcept>
 
 #include <yaml-cpp/yaml.h>
 
 #include "game/AliceCooperNightmareCastle.h"
+#include "Log.h"
 
 const Json::Value AliceCooperNightmareCastle::processHighScores()
 {
@@ -33,7 +33,7 @@ const Json::Value AliceCooperNightmareCastle::processHighScores()
     classicHighScores = YAML::LoadFile(path)["ClassicHighScores"];
   }
   catch (const YAML::Exception& e) {
-    std::cerr << "Failed to load YAML: " << path << "\n" << e.what() << std::endl;
+    LOG_ERROR << "Failed to load YAML: " << path << ": " << e.what();
     throw std::runtime_error("Failed to load high scores from YAML file.");
   }
 
@@ -60,7 +60,7 @@ const Json::Value AliceCooperNightmareCastle::processLastGameScores()
     lastScoreData = YAML::LoadFile(path)["LastScoreData"];
   }
   catch (const YAML::Exception& e) {
-    std::cerr << "Failed to load YAML: " << path << "\n" << e.what() << std::endl;
+    LOG_ERROR << "Failed to load YAML: " << path << ": " << e.what();
     throw std::runtime_error("Failed to load last scores from YAML file.");
   }
 
@@ -75,18 +75,23 @@ const Json::Value AliceCooperNightmareCastle::processLastGameScores()
 uint32_t AliceCooperNightmareCastle::getGamesPlayed()
 {
   YAML::Node audits;
-  std::string path("/game/code/config/" + auditsFile);
+  std::string path(scoresPath + "/" + auditsFile);
 
   try {
     audits = YAML::LoadFile(path)["Audits"];
   }
   catch (const YAML::Exception& e) {
-    std::cerr << "Failed to load YAML: " << path << "\n" << e.what() << std::endl;
+    LOG_ERROR << "Failed to load YAML: " << path << ": " << e.what();
     throw std::runtime_error("Failed to load audits from YAML file.");
   }
 
   return audits["Games Played"].as<uint32_t>();
 }
 
+GameBase::Audits AliceCooperNightmareCastle::processAudits()
+{
+  return parseYamlAudits(scoresPath + "/" + auditsFile);
+}
+
 // vim: set ts=2 sw=2 expandtab:
 
@@ -35,6 +35,7 @@ public:
   const Json::Value processHighScores() override;
   const Json::Value processLastGameScores() override;
   uint32_t getGamesPlayed() override;
+  Audits processAudits() override;
 };
 
 // vim: set ts=2 sw=2 expandtab:
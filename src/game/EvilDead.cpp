@@ -19,9 +19,6 @@
 #include <fstream>
 #include <stdexcept>
 
-#include <unistd.h>
-#include <sys/socket.h>
-#include <sys/un.h>
 #include <json/json.h>
 
 #include "game/EvilDead.h"
@@ -88,7 +85,7 @@ const Json::Value EvilDead::processLastGameScores()
 
 uint32_t EvilDead::getGamesPlayed()
 {
-  std::ifstream ifs("/game/audits/_game_audits.json");
+  std::ifstream ifs((scoresPath + "/" + auditsFile).c_str());
 
   if (!ifs.is_open()) {
     throw std::runtime_error("Failed to open game audits file");
@@ -109,69 +106,12 @@ uint32_t EvilDead::getGamesPlayed()
 
 int EvilDead::sendWindowCommands()
 {
-  int sd = socket(AF_UNIX, SOCK_STREAM, 0);
-  if (sd < 0) {
-    std::cerr << "Failed to create socket" << std::endl;
-    return sd;
-  }
-
-  struct sockaddr_un addr = {};
-  addr.sun_family = AF_UNIX;
-
-  const char* swaypath = getenv("SWAYSOCK");
-  if (!swaypath) {
-    std::cerr << "SWAYSOCK not set" << std::endl;
-    close(sd);
-    return -1;
-  }
-
-  strncpy(addr.sun_path, swaypath, sizeof(addr.sun_path) - 1);
-
-  if (connect(sd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
-    std::cerr << "Failed to connect to sway socket" << std::endl;
-    close(sd);
-    return -1;
-  }
-
-  std::vector<std::string> cmds = {
-    "[title=\"Evil Dead\"] border none",
-    "[title=\"^(Player [1-4]|Spooky Scoreboard Message)$\"] floating enable",
-    "[title=\"^(Player [1-4]|Spooky Scoreboard Message)$\"] sticky enable",
-    "[title=\"^(Player [1-4]|Spooky Scoreboard Message)$\"] border none",
-    "[title=\"^(Player [1-4]|Spooky Scoreboard Message)$\"] focus"
-  };
-
-  for (const auto& cmd : cmds) {
-    std::string msg = "i3-ipc";
-    uint32_t len = static_cast<uint32_t>(cmd.size());
-    uint32_t type = 0;
-
-    // Ensure little-endian for length and type.
-    uint32_t len_le = htole32(len);
-    uint32_t type_le = htole32(type);
-
-    msg.append(reinterpret_cast<const char*>(&len_le), 4);
-    msg.append(reinterpret_cast<const char*>(&type_le), 4);
-    msg.append(cmd);
-
-    if (write(sd, msg.c_str(), msg.size()) != static_cast<ssize_t>(msg.size())) {
-      std::cerr << "Failed writing to sway socket" << std::endl;
-      close(sd);
-      return -1;
-    }
-
-    // Read response to ensure command was processed.
-    char buffer[1024];
-    ssize_t n = read(sd, buffer, sizeof(buffer));
-    if (n <= 0) {
-      std::cerr << "Failed reading response" << std::endl;
-      close(sd);
-      return -1;
-    }
-  }
+  return i3.applyRules();
+}
 
-  close(sd);
-  return 0;
+GameBase::Audits EvilDead::processAudits()
+{
+  return parseJsonAudits(scoresPath + "/" + auditsFile);
 }
 
 // vim: set ts=2 sw=2 expandtab:
@@ -18,6 +18,7 @@
 #pragma once
 
 #include "GameBase.h"
+#include "I3Ipc.h"
 
 class EvilDead: public GameBase
 {
@@ -35,7 +36,11 @@ public:
   const Json::Value processHighScores() override;
   const Json::Value processLastGameScores() override;
   uint32_t getGamesPlayed() override;
+  Audits processAudits() override;
   int sendWindowCommands() override;
+
+private:
+  I3Ipc i3{"SWAYSOCK", "Evil Dead"};
 };
 
 // vim: set ts=2 sw=2 expandtab:
@@ -19,9 +19,6 @@
 #include <fstream>
 #include <stdexcept>
 
-#include <unistd.h>
-#include <sys/socket.h>
-#include <sys/un.h>
 #include <json/json.h>
 
 #include "game/TexasChainsawMassacre.h"
@@ -85,7 +82,7 @@ const Json::Value TexasChainsawMassacre::processLastGameScores()
 
 uint32_t TexasChainsawMassacre::getGamesPlayed()
 {
-  std::ifstream ifs("/game/audits/_game_audits.json");
+  std::ifstream ifs((scoresPath + "/" + auditsFile).c_str());
 
   if (!ifs.is_open()) {
     throw std::runtime_error("Failed to open game audits file");
@@ -106,58 +103,12 @@ uint32_t TexasChainsawMassacre::getGamesPlayed()
 
 int TexasChainsawMassacre::sendWindowCommands()
 {
-  int sd = socket(AF_UNIX, SOCK_STREAM, 0);
-  if (sd < 0) {
-    std::cerr << "Failed to create socket" << std::endl;
-    return sd;
-  }
-
-  struct sockaddr_un addr;
-  addr.sun_family = AF_UNIX;
-
-  const char* i3path = getenv("I3_SOCKET_PATH");
-  if (!i3path) {
-    std::cerr << "I3_SOCKET_PATH environment variable not set" << std::endl;
-    close(sd);
-    return -1;
-  }
-
-  strncpy(addr.sun_path, i3path, sizeof(addr.sun_path) - 1);
-  addr.sun_path[sizeof(addr.sun_path) - 1] = '\0';
-
-  if (connect(sd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
-    std::cerr << "Failed to connect to I3 socket" << std::endl;
-    close(sd);
-    return -1;
-  }
-
-  std::vector<std::string> cmds = {
-    "[title=\"TCM\"] border none",
-    "[title=\"^(Player [1-4]|Spooky Scoreboard Message)$\"] floating enable",
-    "[title=\"^(Player [1-4]|Spooky Scoreboard Message)$\"] sticky enable",
-    "[title=\"^(Player [1-4]|Spooky Scoreboard Message)$\"] border none",
-    "[title=\"^(Player [1-4]|Spooky Scoreboard Message)$\"] focus"
-  };
-
-  for (const auto& cmd : cmds) {
-    std::string msg = "i3-ipc";
-    uint32_t len = static_cast<uint32_t>(cmd.size());
-    uint32_t type = 0;
-
-    msg.append(reinterpret_cast<const char*>(&len), 4);
-    msg.append(reinterpret_cast<const char*>(&type), 4);
-    msg.append(cmd);
-
-    ssize_t n = write(sd, msg.c_str(), msg.size());
-    if (n < 0 || static_cast<size_t>(n) != msg.size()) {
-      std::cerr << "Failed writing to I3 socket" << std::endl;
-      close(sd);
-      return -1;
-    }
-  }
+  return i3.applyRules();
+}
 
-  close(sd);
-  return 0;
+GameBase::Audits TexasChainsawMassacre::processAudits()
+{
+  return parseJsonAudits(scoresPath + "/" + auditsFile);
 }
 
 // vim: set ts=2 sw=2 expandtab:
@@ -52,6 +52,11 @@ const Json::Value TotalNuclearAnnihilation::processLastGameScores()
 
 uint32_t TotalNuclearAnnihilation::getGamesPlayed()
 {
-  YAML::Node config = YAML::LoadFile("/tna/game/config/tna.yaml");
+  YAML::Node config = YAML::LoadFile(scoresPath + "/" + auditsFile);
   return config["Audits"]["Games Played"].as<uint32_t>();
 }
+
+GameBase::Audits TotalNuclearAnnihilation::processAudits()
+{
+  return parseYamlAudits(scoresPath + "/" + auditsFile);
+}
@@ -82,7 +82,7 @@ const Json::Value Ultraman::processLastGameScores()
 
 uint32_t Ultraman::getGamesPlayed()
 {
-  std::ifstream ifs("/game/_game_audits.json");
+  std::ifstream ifs((scoresPath + "/" + auditsFile).c_str());
 
   if (!ifs.is_open()) {
     throw std::runtime_error("Failed to open game audits file");
@@ -101,5 +101,10 @@ uint32_t Ultraman::getGamesPlayed()
   return root["games_played"]["value"].asUInt();
 }
 
+GameBase::Audits Ultraman::processAudits()
+{
+  return parseJsonAudits(scoresPath + "/" + auditsFile);
+}
+
 // vim: set ts=2 sw=2 expandtab:
 
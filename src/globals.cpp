@@ -0,0 +1,30 @@
+// Spooky Scoreboard Daemon
+// Copyright (C) 2025 Greg MacKenzie
+// https://spookyscoreboard.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// Process-wide state shared by the daemon's modules (see main.h).
+// Kept out of main.cpp so the modules can be linked without it.
+// Per-cabinet state belongs in Machine, not here.
+
+#include "main.h"
+
+using namespace std;
+
+atomic<bool> isRunning{false};
+
+unique_ptr<Machine> machine = nullptr;
+
+// vim: set ts=2 sw=2 expandtab:
@@ -15,37 +15,38 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
-#include <cstdint>
 #include <csignal>
+#include <cstring>
 #include <iostream>
 
 #include <unistd.h>
 #include <signal.h>
-#include <sys/inotify.h>
 #include <json/json.h>
 
 #include "main.h"
 #include "x11.h"
-#include "Config.h"
+#include "Player.h"
+#include "QrCode.h"
 #include "Register.h"
 #include "QrScanner.h"
+#include "ScoreWatcher.h"
+#include "Gateway.h"
+#include "AuditCollector.h"
+#include "ScoreHistory.h"
 #include "version.h"
+#include "Log.h"
+#include "Metrics.h"
+#include "Trace.h"
 
 using namespace std;
 
-players playerList;
-
-atomic<bool> isRunning{false};
-
-unique_ptr<GameBase> game = nullptr;
 unique_ptr<QrScanner> qrScanner = nullptr;
-unique_ptr<QrCode> qrCode = nullptr;
-
-shared_ptr<WebSocket> webSocket = nullptr;
-shared_ptr<Player> playerHandler = nullptr;
+static unique_ptr<Gateway> gateway = nullptr;
 
-// todo: Add Message class/ implement some sort of message queue system.
-string serverMessage;
+// Backend URLs given with -w, e.g. to use ssbd-mockserver. Otherwise
+// those in the config are used, or WS_URL.
+static vector<string> wsUrls;
+static int deflateBits = WS_DEFLATE_WINDOW_BITS;
 
 /**
  * Performs cleanup of all resources and threads.
@@ -56,131 +57,61 @@ static void cleanup()
   // Signal all threads to stop.
   isRunning.store(false);
 
+  // Close the connection first; its callbacks reach into the machine.
+  if (machine && machine->webSocket) machine->webSocket->stop();
+
   // Stop QR scanner if running.
   if (qrScanner) {
     qrScanner->stop();
     qrScanner.reset();
   }
 
+  // Stop relaying for other cabinets.
+  if (gateway) gateway.reset();
+
   // Cleanup X11 resources.
   closeWindows();
 
-  // Reset pointers.
-  if (game) game.reset();
-  if (qrCode) qrCode.reset();
-  if (playerHandler) playerHandler.reset();
-  if (webSocket) webSocket.reset();
-}
+  Metrics::stopExporter();
+  Trace::stopSignalListener();
 
-/**
- * Processes high scores from the game and uploads them if they've changed.
- * Maintains the last uploaded score to avoid duplicate uploads.
- */
-static void processHighScoresEvent()
-{
-  static Json::Value lastScore;
-
-  try {
-    Json::Value currentScore = game->processHighScores();
-    if (currentScore != lastScore) {
-      game->uploadScores(currentScore, game->ScoreType::High);
-      lastScore = currentScore;
-    }
-  }
-  catch (const runtime_error& e) {
-    cerr << "Exception: " << e.what() << endl;
-  }
-}
-
-/**
- * Process and upload last game scores.
- */
-static void processLastGameScoresEvent()
-{
-  try {
-    game->uploadScores(game->processLastGameScores(), game->ScoreType::Last);
-    playerList.reset();
-  }
-  catch (const runtime_error& e) {
-    cerr << "Exception: " << e.what() << endl;
-  }
+  // Reset pointers.
+  if (machine) machine.reset();
 }
 
 /**
- * Processes inotify events for file changes.
- * Handles high score file changes and triggers appropriate actions.
- *
- * @param buf The buffer containing the inotify events
- * @param bytes The number of bytes in the buffer
+ * Watches for score file changes until the daemon stops.
  */
-static void processEvent(char* buf, ssize_t bytes)
+static void watch()
 {
-  char* ptr = buf;
-
-  while (ptr < buf + bytes) {
-    struct inotify_event* evt = (struct inotify_event*)ptr;
-
-    if (evt->len > 0) {
-#ifdef DEBUG
-      cout << "Event: " << evt->name << endl;
-#endif
-      if (strcmp(evt->name, game->getHighScoresFile().c_str()) == 0) {
-        processHighScoresEvent();
-      }
-
-      if (strcmp(evt->name, game->getLastScoresFile().c_str()) == 0) {
-        processLastGameScoresEvent();
-      }
-    }
+  ScoreWatcher watcher(*machine);
 
-    ptr += sizeof(struct inotify_event) + evt->len;
+  while (isRunning.load()) {
+    LOG_DEBUG << "Waiting for action...";
+    watcher.handleEvents();
   }
 }
 
-/**
- * Sets up file watching to act on certain file changes.
- */
-static void watch()
+static void connectWebSocket()
 {
-  int fd, wd;
-  char buf[1024];
+  vector<string> urls = wsUrls;
+  if (urls.empty()) urls = machine->config.endpoints;
+  if (urls.empty()) urls.push_back(WS_URL);
 
-  if ((fd = inotify_init()) == -1) {
-    cerr << "Failed inotify_init()." << endl;
-    exit(EXIT_FAILURE);
-  }
-
-  if ((wd = inotify_add_watch(
-    fd, game->getScoresPath().c_str(), IN_CLOSE_WRITE)) == -1) {
-
-    cerr << "Failed inotify_add_watch()." << endl;
-    exit(EXIT_FAILURE);
-  }
-
-  while (isRunning.load()) {
-    cout << "Waiting for action..." << endl;
-    ssize_t n = read(fd, buf, sizeof(buf));
-
-    if (n < 0) {
-      cerr << "Failed reading event." << endl;
-    }
-    else {
-      cout << "Processing event..." << endl;
-      processEvent(buf, n);
-    }
-  }
+  machine->webSocket = make_shared<WebSocket>(urls, *machine);
+  machine->webSocket->setCompression(deflateBits);
+  machine->webSocket->connect();
 }
 
 static void uploadHighScores()
 {
   try {
-    webSocket = make_shared<WebSocket>(WS_URL);
-    webSocket->connect();
-    Json::Value scores = game->processHighScores();
-    game->uploadScores(scores, game->ScoreType::High);
+    connectWebSocket();
+    Json::Value scores = machine->game->processHighScores();
+    machine->game->uploadScores(*machine->webSocket, scores, GameBase::ScoreType::High);
   }
   catch (const runtime_error& e) {
-    cerr << e.what() << endl;
+    LOG_ERROR << e.what();
     exit(EXIT_FAILURE);
   }
   exit(EXIT_SUCCESS);
@@ -189,12 +120,11 @@ static void uploadHighScores()
 static void registerGame(const string& code, const string& path)
 {
   try {
-    webSocket = make_shared<WebSocket>(WS_URL);
-    webSocket->connect();
-    Register(webSocket).registerMachine(code, path).get();
+    connectWebSocket();
+    Register(machine->webSocket).registerMachine(code, path).get();
   }
   catch (const runtime_error& e) {
-    cerr << e.what() << endl;
+    LOG_ERROR << e.what();
     exit(EXIT_FAILURE);
   }
   exit(EXIT_SUCCESS);
@@ -223,8 +153,26 @@ static void printUsage(const char* argv0)
   cerr << "            Use with -r CODE\n\n";
   cerr << "  -u        Upload high scores and exit\n";
   cerr << "            Use with -g GAME\n\n";
+  cerr << "  -m PORT   Also serve metrics on 127.0.0.1:PORT\n";
+  cerr << "            Metrics are always served on a UNIX socket in the tmp path\n\n";
+  cerr << "  -w URL    Connect to URL instead of " << WS_URL << "\n";
+  cerr << "            Repeat to fail over between several; the fastest is used\n";
+  cerr << "            For development against ssbd-mockserver\n\n";
+  cerr << "  -G [ADDR:]PORT\n";
+  cerr << "            Relay other cabinets' traffic over this machine's connection\n";
+  cerr << "            Listens on ADDR (default 127.0.0.1); cabinets connect with\n";
+  cerr << "            -w ws://ADDR:PORT, or wss:// given a certificate\n";
+  cerr << "            Needs \"relay\" settings in .ssbd.json\n\n";
+  cerr << "  -z BITS   Compression window size, 8-15 (default " << WS_DEFLATE_WINDOW_BITS << ")\n";
+  cerr << "            0 disables compression\n\n";
+  cerr << "  -R ROOT   Look for game files under ROOT instead of /\n";
+  cerr << "            For development against ssbd-sim\n\n";
+  cerr << "  -O        Draw panels in a single overlay window\n";
+  cerr << "            Bypasses the window manager (no compositor required)\n\n";
   cerr << "  -l        List supported games\n\n";
-  cerr << "  -h        Displays usage\n" << endl;
+  cerr << "  -h        Displays usage\n\n";
+  cerr << "Signals:" << endl;
+  cerr << "  SIGUSR1   Write a trace of recent events to the tmp path\n" << endl;
   exit(EXIT_SUCCESS);
 }
 
@@ -236,17 +184,19 @@ static void printUsage(const char* argv0)
  */
 static void signalHandler(int signum)
 {
-  cout << "Signal " << signum << " received." << endl;
+  LOG_INFO << "Signal " << signum << " received.";
   exit(signum);
 }
 
 int main(int argc, char** argv)
 {
-  string reg_code, game_name, config_path;
-  bool upload = false, help = false, list = false;
+  string reg_code, game_name, config_path, root;
+  bool upload = false, help = false, list = false, overlay = false;
+  int metrics_port = 0;
+  Gateway::Options gateway_opts;
 
   int opt;
-  while ((opt = getopt(argc, argv, "hlr:uo:g:")) != -1) {
+  while ((opt = getopt(argc, argv, "hlr:uo:g:Om:R:w:G:z:")) != -1) {
     switch (opt) {
     case 'h':
       help = true;
@@ -266,6 +216,29 @@ int main(int argc, char** argv)
     case 'g':
       game_name = optarg;
       break;
+    case 'O':
+      overlay = true;
+      break;
+    case 'm':
+      metrics_port = atoi(optarg);
+      break;
+    case 'R':
+      root = optarg;
+      break;
+    case 'w':
+      wsUrls.push_back(optarg);
+      break;
+    case 'G': {
+      const char* colon = strrchr(optarg, ':');
+      if (colon) gateway_opts.host.assign(optarg, static_cast<size_t>(colon - optarg));
+      gateway_opts.port = atoi(colon ? colon + 1 : optarg);
+      if (gateway_opts.port <= 0) printUsage(argv[0]);
+      break;
+    }
+    case 'z':
+      deflateBits = atoi(optarg);
+      if (deflateBits != 0 && (deflateBits < 8 || deflateBits > 15)) help = true;
+      break;
     }
   }
 
@@ -277,6 +250,8 @@ int main(int argc, char** argv)
     printSupportedGames();
   }
 
+  Log::start();
+  atexit(Log::stop);
   atexit(cleanup);
   signal(SIGINT, signalHandler);
   signal(SIGTERM, signalHandler);
@@ -285,62 +260,97 @@ int main(int argc, char** argv)
     printUsage(argv[0]);
   }
 
-  game = GameBase::create(game_name);
+  unique_ptr<GameBase> game = GameBase::create(game_name);
   if (!game) {
-    cerr << "Invalid game name: " << game_name << endl;
+    LOG_ERROR << "Invalid game name: " << game_name;
     exit(EXIT_FAILURE);
   }
 
-  cout << game->getGameName() << " - SSBd v" << Version::FULL << endl;
+  if (!root.empty()) game->relocate(root);
+
+  machine = make_unique<Machine>(move(game));
+  const GameBase& g = *machine->game;
+
+  LOG_INFO << g.getGameName() << " - SSBd v" << Version::FULL;
 
   if (!reg_code.empty()) {
-    const string path = config_path.empty() ? Config::getDefaultPath() : config_path;
+    const string path = config_path.empty() ? machine->config.getDefaultPath() : config_path;
     registerGame(reg_code, path);
   }
 
-  Config::load();
+  try {
+    machine->config.load();
+  }
+  catch (const runtime_error& e) {
+    LOG_ERROR << e.what();
+    exit(EXIT_FAILURE);
+  }
 
   if (upload) {
     uploadHighScores();
   }
 
+  Metrics::startExporter(g.getTmpPath() + "/ssbd-metrics.sock", metrics_port);
+  Trace::startSignalListener(g.getTmpPath());
+
   try {
-    webSocket = make_shared<WebSocket>(WS_URL);
-    webSocket->connect();
+    machine->showWindow = startWindowThread;
+    connectWebSocket();
 
     isRunning.store(true);
 
+    if (gateway_opts.port > 0) {
+      gateway_opts.secret = machine->config.relaySecret;
+      gateway_opts.certFile = machine->config.relayCert;
+      gateway_opts.keyFile = machine->config.relayKey;
+      gateway = make_unique<Gateway>(gateway_opts, machine->webSocket);
+      gateway->start();
+    }
+
+    // Keep a local history of games, for personal bests.
+    try {
+      machine->history = make_unique<ScoreHistory>(g.getGamePath() + "/.ssbd-history");
+    }
+    catch (const runtime_error& e) {
+      LOG_ERROR << e.what();
+    }
+
     // Instantiate player class.
-    playerHandler = make_shared<Player>(webSocket);
+    machine->playerHandler = make_shared<Player>(*machine);
+
+    // Upload audit counters as they change.
+    machine->auditCollector = make_unique<AuditCollector>(*machine);
+    machine->auditCollector->start();
 
     // Start QR scanner.
-    qrScanner = make_unique<QrScanner>("/dev/ttyQR");
+    qrScanner = make_unique<QrScanner>("/dev/ttyQR", machine->playerHandler);
     qrScanner->start();
 
     // Fetch the machine's QR code.
     // The code is displayed when a user logs in,
     // which redirects to leaderboard page.
-    qrCode = make_unique<QrCode>(webSocket);
-    qrCode->download().get();
+    machine->qrCode = make_unique<QrCode>(machine->webSocket);
+    machine->qrCode->download().get();
 
     // Initialize player windows.
     // Player windows are opened, but remain hidden
     // off screen until a user logs in or a message is received.
+    setOverlayMode(overlay);
     openWindows();
 
     // Start main loop and watch for action.
     watch();
   }
   catch (const system_error& e) {
-    cerr << e.what() << endl;
+    LOG_ERROR << e.what();
     exit(EXIT_FAILURE);
   }
   catch (const runtime_error& e) {
-    cerr << e.what() << endl;
+    LOG_ERROR << e.what();
     exit(EXIT_FAILURE);
   }
   catch (const future_error& e) {
-    cerr << e.what() << endl;
+    LOG_ERROR << e.what();
     exit(EXIT_FAILURE);
   }
 
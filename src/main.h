@@ -17,14 +17,10 @@
 
 #pragma once
 
-#include <string>
-#include <array>
 #include <atomic>
+#include <memory>
 
-#include "GameBase.h"
-#include "QrCode.h"
-#include "WebSocket.h"
-#include "Player.h"
+#include "Machine.h"
 
 #define MAX_UUID_LEN 36
 
@@ -34,23 +30,10 @@
 #define WS_URL "wss://spookyscoreboard.com:4444"
 #endif
 
-struct players {
-  uint8_t numPlayers{0};
-  std::array<std::string, 4> player{};
-
-  void reset() {
-    numPlayers = 0;
-    std::fill(player.begin(), player.end(), "");
-  }
-};
-
-extern players playerList;
 extern std::atomic<bool> isRunning;
-extern std::unique_ptr<GameBase> game;
-extern std::unique_ptr<QrCode> qrCode;
-extern std::shared_ptr<WebSocket> webSocket;
-extern std::shared_ptr<Player> playerHandler;
-extern std::string serverMessage;
+
+// The cabinet this daemon runs, and whose panels x11 draws.
+extern std::unique_ptr<Machine> machine;
 
 // vim: set ts=2 sw=2 expandtab:
 
@@ -15,7 +15,6 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
-#include <iostream>
 #include <fstream>
 #include <thread>
 #include <mutex>
@@ -29,11 +28,14 @@
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
 #include <X11/Xft/Xft.h>
-#include <X11/xpm.h>
+#include <X11/extensions/shape.h>
 
 #include "main.h"
 #include "x11.h"
+#include "QrCode.h"
 #include "version.h"
+#include "Log.h"
+#include "Metrics.h"
 
 #include "font/Ghoulish.h"
 #include "font/Roboto.h"
@@ -41,6 +43,7 @@
 #define X11_WIN_WIDTH 320
 #define X11_WIN_HEIGHT 480
 #define X11_WIN_GAP 10
+#define X11_QR_SIZE 145
 
 using namespace std;
 
@@ -49,6 +52,8 @@ GC gc[5] = {nullptr, nullptr, nullptr, nullptr, nullptr};
 XftDraw* xft_draw[5] = {nullptr, nullptr, nullptr, nullptr, nullptr};
 Pixmap pixmap_buf[5] = {None, None, None, None, None};
 Pixmap pixmap_qr = None;
+Window overlay = None;
+Pixmap pixmap_overlay = None;
 Colormap colormap = None;
 Display* display = nullptr;
 XftFont* xft_hdr_font = nullptr;
@@ -60,6 +65,19 @@ XftColor xft_color = {0, 0, 0, 0, 0};
 mutex timer_mtx, thread_mtx;
 vector<bool> windowThread = vector<bool>(5, false);
 
+// Overlay mode draws every panel into one override-redirect window.
+bool overlay_mode = false;
+bool panel_visible[5] = {false, false, false, false, false};
+
+/**
+ * Enables the compositor-less overlay mode.
+ * Must be called before openWindows().
+ */
+void setOverlayMode(bool enable)
+{
+  overlay_mode = enable;
+}
+
 /**
  * Initializes the X11 display connection and set up the display environment.
  * This function must be called before any other X11 operations.
@@ -70,7 +88,7 @@ void x11Init()
   setenv("DISPLAY", ":0", 0);
   display = XOpenDisplay(nullptr);
   if (!display) {
-    cerr << "Failed to open X11 display." << endl;
+    LOG_ERROR << "Failed to open X11 display.";
     exit(EXIT_FAILURE);
   }
 }
@@ -87,7 +105,7 @@ static void loadFont(const char* path, const unsigned char* data, size_t size, F
 {
   ofstream font_file(path, ios::binary);
   if (!font_file) {
-    cerr << "Failed to open font file for writing." << endl;
+    LOG_ERROR << "Failed to open font file for writing.";
     exit(EXIT_FAILURE);
   }
 
@@ -95,7 +113,7 @@ static void loadFont(const char* path, const unsigned char* data, size_t size, F
   font_file.close();
 
   if (!FcConfigAppFontAddFile(config, (const FcChar8*)path)) {
-    cerr << "Failed to add font file to Fontconfig." << endl;
+    LOG_ERROR << "Failed to add font file to Fontconfig.";
     exit(EXIT_FAILURE);
   }
 }
@@ -136,6 +154,141 @@ static Window createWindow(int x, int y, int w, int h, const string& title, int
   return win;
 }
 
+/**
+ * Create a screen-wide override-redirect window holding all panels.
+ * The window manager never sees it; a shape mask limits it to the
+ * panels that are currently visible.
+ */
+static Window createOverlay(int y, int w, int h, int scr)
+{
+  XSetWindowAttributes attrs;
+  memset(&attrs, 0, sizeof(XSetWindowAttributes));
+  attrs.override_redirect = True;
+  attrs.background_pixmap = None;
+
+  Window win = XCreateWindow(
+    display,
+    RootWindow(display, scr),
+    0, y, w, h, 0,
+    CopyFromParent, InputOutput, CopyFromParent,
+    CWOverrideRedirect | CWBackPixmap, &attrs);
+
+  XStoreName(display, win, "Spooky Scoreboard");
+
+  // Start with an empty shape; nothing is visible yet.
+  XShapeCombineRectangles(display, win, ShapeBounding, 0, 0, nullptr, 0, ShapeSet, Unsorted);
+  XShapeCombineRectangles(display, win, ShapeInput, 0, 0, nullptr, 0, ShapeSet, Unsorted);
+
+  return win;
+}
+
+/**
+ * Whether a panel is on screen, or about to be when index matches.
+ * Caller must hold timer_mtx.
+ */
+static bool isPanelVisible(int i, int index = -1)
+{
+  if (i == index) return true;
+  if (overlay_mode) return panel_visible[i];
+
+  XWindowAttributes attr;
+  return XGetWindowAttributes(display, window[i], &attr) && attr.map_state == IsViewable;
+}
+
+/**
+ * Lay out visible panels centered in a row.
+ *
+ * @param xs Receives the x position of each visible panel.
+ * @param index The panel about to be shown (use -1 if hiding one).
+ * @return Number of visible panels.
+ */
+static int layoutPanels(int xs[5], int index = -1)
+{
+  int n = 0;
+  for (int i = 0; i < 5; i++) {
+    if (isPanelVisible(i, index)) n++;
+  }
+
+  int total_width = (n * X11_WIN_WIDTH) + ((n - 1) * X11_WIN_GAP);
+  int current_x = (DisplayWidth(display, DefaultScreen(display)) - total_width) / 2;
+
+  for (int i = 0; i < 5; i++) {
+    xs[i] = -1;
+    if (isPanelVisible(i, index)) {
+      xs[i] = current_x;
+      current_x += X11_WIN_WIDTH + X11_WIN_GAP;
+    }
+  }
+
+  return n;
+}
+
+/**
+ * Present all visible panels with a single copy to the overlay window.
+ * Caller must hold timer_mtx.
+ */
+static void presentOverlay()
+{
+  int xs[5];
+  if (layoutPanels(xs) == 0) return;
+
+  int left = -1, right = 0;
+  for (int i = 0; i < 5; i++) {
+    if (xs[i] < 0) continue;
+    XCopyArea(display, pixmap_buf[i], pixmap_overlay, gc[i],
+              0, 0, X11_WIN_WIDTH, X11_WIN_HEIGHT, xs[i], 0);
+    if (left < 0) left = xs[i];
+    right = xs[i] + X11_WIN_WIDTH;
+  }
+
+  XCopyArea(display, pixmap_overlay, overlay, gc[4],
+            left, 0, static_cast<unsigned int>(right - left), X11_WIN_HEIGHT, left, 0);
+}
+
+/**
+ * Update the overlay shape mask to match visible panels.
+ * Caller must hold timer_mtx.
+ */
+static void updateOverlayShape()
+{
+  int xs[5];
+  int n = layoutPanels(xs);
+
+  if (n == 0) {
+    XUnmapWindow(display, overlay);
+    return;
+  }
+
+  XRectangle rects[5];
+  int r = 0;
+  for (int i = 0; i < 5; i++) {
+    if (xs[i] < 0) continue;
+    rects[r].x = static_cast<short>(xs[i]);
+    rects[r].y = 0;
+    rects[r].width = X11_WIN_WIDTH;
+    rects[r].height = X11_WIN_HEIGHT;
+    r++;
+  }
+
+  XShapeCombineRectangles(display, overlay, ShapeBounding, 0, 0, rects, r, ShapeSet, YXBanded);
+  XShapeCombineRectangles(display, overlay, ShapeInput, 0, 0, rects, r, ShapeSet, YXBanded);
+  XMapRaised(display, overlay);
+}
+
+/**
+ * Copy a panel's back buffer to the screen.
+ */
+static void presentPanel(int index)
+{
+  if (overlay_mode) {
+    presentOverlay();
+  }
+  else {
+    XCopyArea(display, pixmap_buf[index], window[index], gc[index],
+              0, 0, X11_WIN_WIDTH, X11_WIN_HEIGHT, 0, 0);
+  }
+}
+
 static vector<string> wrapText(const string& text, XftFont* font, int max_pixel_width)
 {
   if (text.empty() || max_pixel_width <= 0) return {};
@@ -202,6 +355,22 @@ static vector<string> wrapText(const string& text, XftFont* font, int max_pixel_
   return lines;
 }
 
+/**
+ * Formats a score with thousands separators, e.g. 12,345,670.
+ */
+static string formatScore(uint64_t score)
+{
+  string digits = to_string(score);
+  string out;
+
+  for (size_t i = 0; i < digits.size(); i++) {
+    if (i > 0 && (digits.size() - i) % 3 == 0) out += ',';
+    out += digits[i];
+  }
+
+  return out;
+}
+
 /**
  * Draws the content for a specific window.
  *
@@ -211,21 +380,23 @@ static vector<string> wrapText(const string& text, XftFont* font, int max_pixel_
  */
 void drawWindow(int index)
 {
-  if (index < 0 || index > 4 || window[index] == None) {
-    cerr << "Invalid window index: " << index << endl;
+  if (index < 0 || index > 4 || pixmap_buf[index] == None) {
+    LOG_ERROR << "Invalid window index: " << index;
     return;
   }
 
-  if (index < 4 && playerList.player[index].empty()) return;
+  if (index < 4 && machine->playerList.player[index].empty()) return;
+
+  static Metrics::Histogram& redraw = Metrics::histogram(
+    "ssbd_redraw_seconds", "Time to draw and present one panel.");
+  Metrics::Timer timer(redraw);
 
   int screen = DefaultScreen(display);
 
   XGlyphInfo ext;
-  XWindowAttributes attr;
-  XGetWindowAttributes(display, window[index], &attr);
 
-  int w = attr.width;
-  int h = attr.height;
+  int w = X11_WIN_WIDTH;
+  int h = X11_WIN_HEIGHT;
   int center_x = w / 2;
   int header_y;
 
@@ -252,17 +423,36 @@ void drawWindow(int index)
                  center_x - ext.width / 2, header_y,
                  (const FcChar8*)scoreboard, 10);
 
-  // Draw QR code.
-  int qr_x = center_x - 72; // 145/2 = 72
+  // Draw QR code; set bits take the foreground, clear bits the background.
+  int qr_x = center_x - X11_QR_SIZE / 2;
   int qr_y = header_y + 10;
-  XCopyArea(display, pixmap_qr, pixmap_buf[index], gc[index], 0, 0, 145, 145, qr_x, qr_y);
+  if (pixmap_qr != None) {
+    XSetBackground(display, gc[index], WhitePixel(display, screen));
+    XCopyPlane(display, pixmap_qr, pixmap_buf[index], gc[index],
+               0, 0, X11_QR_SIZE, X11_QR_SIZE, qr_x, qr_y, 1);
+  }
 
   // Main text area.
-  int text_area_top = qr_y + 145 + 45;
-  string text = (index < 4) ? playerList.player[index] : serverMessage;
+  int text_area_top = qr_y + X11_QR_SIZE + 45;
+  string text = (index < 4) ? machine->playerList.player[index] : machine->messages.current();
   auto lines = wrapText(text, xft_std_font, w - 10);
 
+  // Without a message, the message window shows the leaderboard.
+  if (index == 4 && text.empty()) {
+    int rank = 1;
+    for (const auto& entry : machine->leaderboard.top(LEADERBOARD_TOP)) {
+      lines.push_back(to_string(rank++) + ". " + entry.name + " " + formatScore(entry.score));
+    }
+  }
+
+  // The player's best on this machine, from the local score history.
+  string best;
+  if (index < 4 && machine->playerList.best[index] > 0) {
+    best = "Best: " + formatScore(machine->playerList.best[index]);
+  }
+
   int block_h = static_cast<int>(lines.size()) * xft_std_font->height;
+  if (!best.empty()) block_h += xft_sub_font->height;
   int block_y = text_area_top + (h - text_area_top - block_h) / 2;
 
   if (index < 4) {
@@ -293,6 +483,17 @@ void drawWindow(int index)
     block_y += xft_std_font->height;
   }
 
+  if (!best.empty()) {
+    XftTextExtents8(display, xft_sub_font,
+                    (const FcChar8*)best.c_str(),
+                    static_cast<int>(best.length()), &ext);
+
+    XftDrawString8(xft_draw[index], &xft_color, xft_sub_font,
+                   center_x - ext.width / 2, block_y,
+                   (const FcChar8*)best.c_str(),
+                   static_cast<int>(best.length()));
+  }
+
   // Version string.
   string ver = Version::FULL;
   XftTextExtents8(display, xft_sub_font,
@@ -304,8 +505,8 @@ void drawWindow(int index)
                  (FcChar8*)ver.c_str(),
                  static_cast<int>(ver.length()));
 
-  // Copy pixmap buffer to the window.
-  XCopyArea(display, pixmap_buf[index], window[index], gc[index], 0, 0, w, h, 0, 0);
+  // Copy pixmap buffer to the screen.
+  presentPanel(index);
 
   // Display it all.
   XFlush(display);
@@ -320,8 +521,7 @@ void drawWindow(int index)
  */
 static void runTimer(int secs, int index)
 {
-  XWindowAttributes attr;
-  if (!XGetWindowAttributes(display, window[index], &attr)) return;
+  if (pixmap_buf[index] == None) return;
 
   struct timeval start, now;
   gettimeofday(&start, nullptr);
@@ -336,10 +536,8 @@ static void runTimer(int secs, int index)
     {
       lock_guard<mutex> lock(timer_mtx);
 
-      if (!XGetWindowAttributes(display, window[index], &attr)) break;
-
-      int w = attr.width;
-      int h = attr.height;
+      int w = X11_WIN_WIDTH;
+      int h = X11_WIN_HEIGHT;
 
       XSetForeground(display, gc[index], WhitePixel(display, DefaultScreen(display)));
       XFillRectangle(display, pixmap_buf[index], gc[index], 0, h - xft_sub_font->height - 10, w, h);
@@ -355,7 +553,6 @@ static void runTimer(int secs, int index)
                      (FcChar8*)ct.c_str(),
                      static_cast<int>(ct.length()));
 
-      XCopyArea(display, pixmap_buf[index], window[index], gc[index], 0, h, w, h, 0, h);
       drawWindow(index);
     }
 
@@ -370,48 +567,42 @@ static void runTimer(int secs, int index)
  */
 static void repositionPlayerWindows(int index = -1)
 {
-  int windows_open = 0;
-  int w = DisplayWidth(display, DefaultScreen(display));
+  int xs[5];
   int h = DisplayHeight(display, DefaultScreen(display));
-  XWindowAttributes attr;
-
-  // Count visible windows including the one about to be shown.
-  for (int i = 0; i < 5; i++) {
-    if (XGetWindowAttributes(display, window[i], &attr)) {
-      if (attr.map_state == IsViewable || i == index) windows_open++;
-    }
-  }
 
-  // Calculate total width and starting x position.
-  int total_width = (windows_open * X11_WIN_WIDTH) + ((windows_open - 1) * X11_WIN_GAP);
-  int current_x = (w - total_width) / 2;
+  layoutPanels(xs, index);
 
   // Position each open window.
   for (int i = 0; i < 5; i++) {
-    if (XGetWindowAttributes(display, window[i], &attr)) {
-      if (attr.map_state == IsViewable || i == index) {
-        XMoveWindow(display, window[i], current_x, (h - X11_WIN_HEIGHT) / 2);
-        current_x += X11_WIN_WIDTH + X11_WIN_GAP;
-      }
-    }
+    if (xs[i] >= 0) XMoveWindow(display, window[i], xs[i], (h - X11_WIN_HEIGHT) / 2);
   }
 }
 
 /**
  * Show a player window by mapping it and raising it above other windows.
- * Also sends an i3 command for games that require it.
+ * In overlay mode the panel is added to the overlay shape instead.
  *
  * @param index The index of the window to show (0-4)
  */
 static void showWindow(int index)
 {
-  cout << "Showing window: " << index << endl;
+  LOG_INFO << "Showing window: " << index;
 
   {
     lock_guard<mutex> lock(timer_mtx);
-    XMapWindow(display, window[index]);
-    repositionPlayerWindows(index);
-    XRaiseWindow(display, window[index]);
+
+    if (overlay_mode) {
+      // Redraw first, or the panel briefly shows its previous content.
+      drawWindow(index);
+      panel_visible[index] = true;
+      updateOverlayShape();
+      presentOverlay();
+    }
+    else {
+      XMapWindow(display, window[index]);
+      repositionPlayerWindows(index);
+      XRaiseWindow(display, window[index]);
+    }
   }
 
   XSync(display, False);
@@ -424,30 +615,57 @@ static void showWindow(int index)
  */
 static void hideWindow(int index)
 {
-  cout << "Hiding window: " << index << endl;
+  LOG_INFO << "Hiding window: " << index;
 
   {
     lock_guard<mutex> lock(timer_mtx);
-    XUnmapWindow(display, window[index]);
-    repositionPlayerWindows();
+
+    if (overlay_mode) {
+      panel_visible[index] = false;
+      updateOverlayShape();
+      presentOverlay();
+    }
+    else {
+      XUnmapWindow(display, window[index]);
+      repositionPlayerWindows();
+    }
   }
 
   XSync(display, False);
 }
 
+/**
+ * Shows queued server messages one after another, each for its own
+ * duration, then hides the message window.
+ */
+static void showMessages()
+{
+  MessageQueue::Message msg;
+  if (!machine->messages.next(msg)) return;
+
+  showWindow(4);
+  if (!overlay_mode) machine->game->sendWindowCommands();
+
+  do {
+    runTimer(msg.duration, 4);
+  } while (isRunning.load() && machine->messages.next(msg));
+
+  hideWindow(4);
+}
+
 /**
  * Run each window in a separate thread.
  * Each window has its own countdown timer.
  */
 void startWindowThread(int index)
 {
-  if (index < 0 || index > 4 || window[index] == None) return;
+  if (index < 0 || index > 4 || pixmap_buf[index] == None) return;
 
   {
     lock_guard<mutex> lock(thread_mtx);
 
     if (windowThread[index]) {
-      cout << "Thread running for window: " << index << endl;
+      LOG_INFO << "Thread running for window: " << index;
       return;
     }
 
@@ -455,14 +673,23 @@ void startWindowThread(int index)
   }
 
   thread([index]() {
-    showWindow(index);
-    game->sendWindowCommands();
-    runTimer(TIMER_DEFAULT, index);
-    hideWindow(index);
+    if (index == 4) {
+      showMessages();
+    }
+    else {
+      showWindow(index);
+      if (!overlay_mode) machine->game->sendWindowCommands();
+      runTimer(TIMER_DEFAULT, index);
+      hideWindow(index);
+    }
+
     {
       lock_guard<mutex> lock(thread_mtx);
       windowThread[index] = false;
     }
+
+    // A message queued as the window closed would otherwise wait for the next.
+    if (index == 4 && isRunning.load() && machine->messages.ready()) startWindowThread(4);
   }).detach();
 }
 
@@ -497,6 +724,12 @@ void closeWindows()
       }
     }
 
+    // Free overlay back buffer.
+    if (pixmap_overlay != None) {
+      XFreePixmap(display, pixmap_overlay);
+      pixmap_overlay = None;
+    }
+
     // Free qr code pixmap.
     if (pixmap_qr != None) {
       XFreePixmap(display, pixmap_qr);
@@ -525,8 +758,8 @@ void closeWindows()
     }
 
     // Remove temporary font files.
-    remove((game->getTmpPath() + "/ghoulish.ttf").c_str());
-    remove((game->getTmpPath() + "/roboto.ttf").c_str());
+    remove((machine->game->getTmpPath() + "/ghoulish.ttf").c_str());
+    remove((machine->game->getTmpPath() + "/roboto.ttf").c_str());
 
     // Destroy windows.
     for (int i = 0; i < 5; i++) {
@@ -536,6 +769,11 @@ void closeWindows()
       }
     }
 
+    if (overlay != None) {
+      XDestroyWindow(display, overlay);
+      overlay = None;
+    }
+
     // Finish up.
     XFlush(display);
     XSync(display, False);
@@ -561,37 +799,41 @@ void openWindows()
   int wh = X11_WIN_HEIGHT;
 
   // Load shared resources first.
-  int rc = XpmReadFileToPixmap(
-    display,
-    RootWindow(display, screen),
-    qrCode->getPath().c_str(),
-    &pixmap_qr, NULL, NULL);
+  // The QR code is uploaded once as a 1-bit bitmap scaled to panel size.
+  vector<char> qr_bits = machine->qrCode->getBitmap(X11_QR_SIZE);
+  if (!qr_bits.empty()) {
+    pixmap_qr = XCreateBitmapFromData(
+      display,
+      RootWindow(display, screen),
+      qr_bits.data(),
+      X11_QR_SIZE, X11_QR_SIZE);
+  }
 
-  if (rc != XpmSuccess) {
-    cerr << "Failed to create pixmap: " << XpmGetErrorString(rc) << endl;
+  if (pixmap_qr == None) {
+    LOG_ERROR << "Failed to create QR code bitmap.";
   }
 
   // Load TTF fonts.
   FcConfig* fc_config = FcInitLoadConfigAndFonts();
-  loadFont((game->getTmpPath() + "/ghoulish.ttf").c_str(), Ghoulish_ttf, Ghoulish_ttf_len, fc_config);
-  loadFont((game->getTmpPath() + "/roboto.ttf").c_str(), Roboto_ttf, Roboto_ttf_len, fc_config);
+  loadFont((machine->game->getTmpPath() + "/ghoulish.ttf").c_str(), Ghoulish_ttf, Ghoulish_ttf_len, fc_config);
+  loadFont((machine->game->getTmpPath() + "/roboto.ttf").c_str(), Roboto_ttf, Roboto_ttf_len, fc_config);
   FcConfigSetCurrent(fc_config);
 
   xft_std_font = XftFontOpenName(display, screen, "Ghoulish:size=31");
   if (!xft_std_font) {
-    cerr << "Failed to open standard TTF font." << endl;
+    LOG_ERROR << "Failed to open standard TTF font.";
     exit(EXIT_FAILURE);
   }
 
   xft_hdr_font = XftFontOpenName(display, screen, "Ghoulish:size=38");
   if (!xft_hdr_font) {
-    cerr << "Failed to open header TTF font." << endl;
+    LOG_ERROR << "Failed to open header TTF font.";
     exit(EXIT_FAILURE);
   }
 
   xft_sub_font = XftFontOpenName(display, screen, "Roboto:size=16");
   if (!xft_sub_font) {
-    cerr << "Failed to open sub TTF font." << endl;
+    LOG_ERROR << "Failed to open sub TTF font.";
     exit(EXIT_FAILURE);
   }
 
@@ -606,6 +848,28 @@ void openWindows()
     "black",
     &xft_color);
 
+  // Overlay mode requires the X Shape extension.
+  if (overlay_mode) {
+    int shape_event, shape_error;
+    if (!XShapeQueryExtension(display, &shape_event, &shape_error)) {
+      LOG_ERROR << "X Shape extension unavailable, using regular windows.";
+      overlay_mode = false;
+    }
+  }
+
+  // Create a single overlay window and its back buffer.
+  if (overlay_mode) {
+    overlay = createOverlay((h - wh) / 2, w, wh, screen);
+    pixmap_overlay = XCreatePixmap(display, overlay,
+      static_cast<unsigned int>(w), X11_WIN_HEIGHT,
+      static_cast<unsigned int>(DefaultDepth(display, screen)));
+
+    if (overlay == None || pixmap_overlay == None) {
+      LOG_ERROR << "Failed to create overlay window";
+      exit(EXIT_FAILURE);
+    }
+  }
+
   // Create 4 player windows.
   for (int i = 0; i < 5; i++) {
     int x;
@@ -622,27 +886,33 @@ void openWindows()
 
     int y = (h - wh) / 2;
 
-    window[i] = createWindow(x, y, ww, wh, title, screen);
-    if (window[i] == None) {
-      cerr << "Failed to create window " << i << endl;
-      exit(EXIT_FAILURE);
+    // Overlay panels are drawn off screen and composed into one window.
+    Drawable drawable = RootWindow(display, screen);
+
+    if (!overlay_mode) {
+      window[i] = createWindow(x, y, ww, wh, title, screen);
+      if (window[i] == None) {
+        LOG_ERROR << "Failed to create window " << i;
+        exit(EXIT_FAILURE);
+      }
+      drawable = window[i];
     }
 
     // Create graphics context for this window.
-    gc[i] = XCreateGC(display, window[i], 0, NULL);
+    gc[i] = XCreateGC(display, drawable, 0, NULL);
     if (!gc[i]) {
-      cerr << "Failed to create GC for window " << i << endl;
+      LOG_ERROR << "Failed to create GC for window " << i;
       exit(EXIT_FAILURE);
     }
 
     // Setup pixmap buffer for this window.
     // This will act as a double-buffer for drawing text and QR code.
-    pixmap_buf[i] = XCreatePixmap(display, window[i],
+    pixmap_buf[i] = XCreatePixmap(display, drawable,
       X11_WIN_WIDTH, X11_WIN_HEIGHT,
       DefaultDepth(display, screen));
 
     if (pixmap_buf[i] == None) {
-      cerr << "Failed to create pixmap buffer window " << i << endl;
+      LOG_ERROR << "Failed to create pixmap buffer window " << i;
       continue;
     }
 
@@ -654,7 +924,7 @@ void openWindows()
       colormap);
 
     if (!xft_draw[i]) {
-      cerr << "Failed to create XftDraw for pixmap buffer " << i << endl;
+      LOG_ERROR << "Failed to create XftDraw for pixmap buffer " << i;
       exit(EXIT_FAILURE);
     }
   }
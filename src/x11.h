@@ -20,6 +20,7 @@
 #define TIMER_DEFAULT 15
 
 void x11Init();
+void setOverlayMode(bool enable);
 void drawWindow(int index);
 void openWindows();
 void closeWindows();
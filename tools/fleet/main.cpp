@@ -0,0 +1,373 @@
+// Spooky Scoreboard Daemon
+// Copyright (C) 2025 Greg MacKenzie
+// https://spookyscoreboard.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// ssbd-fleet: runs many simulated cabinets in one process.
+//
+// Each cabinet is a full Machine with its own connection, score files
+// under ROOT/cabN, and a fake QR scanner, but no display. Games end at
+// random and the daemon's watcher uploads the scores, so pointing the
+// fleet at ssbd-mockserver load-tests the whole protocol path and shows
+// what each machine costs in CPU and memory.
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <uuid/uuid.h>
+
+#include "main.h"
+#include "Player.h"
+#include "ScoreWatcher.h"
+#include "AuditCollector.h"
+#include "ScoreHistory.h"
+#include "version.h"
+#include "Log.h"
+#include "Metrics.h"
+#include "sim/ScoreWriter.h"
+
+using namespace std;
+
+static atomic<bool> running{true};
+
+struct Cabinet {
+  unique_ptr<Machine> machine;
+  unique_ptr<ScoreWriter> writer;
+  unique_ptr<ScoreWatcher> watcher;
+};
+
+static void printUsage(const char* argv0)
+{
+  cerr << "Spooky Scoreboard fleet simulator (ssbd-fleet) v" << Version::FULL << "\n";
+  cerr << "Usage: " << argv0 << " -R ROOT [OPTIONS]" << "\n\n";
+  cerr << "Options:" << endl;
+  cerr << "  -R ROOT   Directory to build the cabinets' file systems under\n\n";
+  cerr << "  -c COUNT  Number of cabinets (default 100)\n\n";
+  cerr << "  -g GAME   Game every cabinet runs (default all games in turn)\n\n";
+  cerr << "  -w URL    Server to connect to (default ws://127.0.0.1:4444)\n\n";
+  cerr << "  -p RATE   Average games per hour, per cabinet (default 6)\n\n";
+  cerr << "  -s SPEED  Time compression (default 1)\n\n";
+  cerr << "  -d TIME   Simulated time to run, e.g. 90m, 12h, 30d (default forever)\n\n";
+  cerr << "  -q PROB   Chance each player position scans in before a game (default 0.3)\n\n";
+  cerr << "  -r RATE   Cabinets connected per second at start up (default 50)\n\n";
+  cerr << "  -m PORT   Also serve metrics on 127.0.0.1:PORT\n\n";
+  cerr << "  -n SEED   Random seed (default random)\n\n";
+  cerr << "  -h        Displays usage\n" << endl;
+  exit(EXIT_SUCCESS);
+}
+
+/**
+ * Parses a duration like "45s", "90m", "12h" or "30d" into seconds.
+ */
+static double parseDuration(const char* arg)
+{
+  char* end;
+  double v = strtod(arg, &end);
+
+  switch (*end) {
+  case 'd': return v * 86400;
+  case 'h': return v * 3600;
+  case 'm': return v * 60;
+  default: return v;
+  }
+}
+
+/**
+ * Resident set size in kilobytes.
+ */
+static long residentKb()
+{
+  long pages = 0, rss = 0;
+  FILE* f = fopen("/proc/self/statm", "r");
+  if (!f) return 0;
+  if (fscanf(f, "%ld %ld", &pages, &rss) != 2) rss = 0;
+  fclose(f);
+  return rss * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+/**
+ * User and system CPU time used so far, in seconds.
+ */
+static double cpuSeconds()
+{
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return static_cast<double>(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) +
+         static_cast<double>(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+/**
+ * Scans players in the way the QR scanner would, with random UUIDs.
+ */
+static void fakeScan(Machine& m, double chance, mt19937_64& rng)
+{
+  for (int position = 1; position <= 4; position++) {
+    if (!bernoulli_distribution(chance)(rng)) continue;
+
+    uuid_t uuid;
+    char id[37];
+    uuid_generate_random(uuid);
+    uuid_unparse_lower(uuid, id);
+
+    m.playerHandler->login(vector<char>(id, id + MAX_UUID_LEN), position);
+  }
+}
+
+/**
+ * Hands score file events to each cabinet's watcher, all on one thread.
+ */
+static void watchAll(vector<Cabinet>& cabinets)
+{
+  int ep = epoll_create1(EPOLL_CLOEXEC);
+  if (ep < 0) {
+    LOG_ERROR << "Failed epoll_create1().";
+    running.store(false);
+    return;
+  }
+
+  for (auto& cab : cabinets) {
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.ptr = cab.watcher.get();
+    epoll_ctl(ep, EPOLL_CTL_ADD, cab.watcher->getFd(), &ev);
+  }
+
+  struct epoll_event events[64];
+
+  while (running.load()) {
+    int n = epoll_wait(ep, events, 64, 50);
+    for (int i = 0; i < n; i++) {
+      static_cast<ScoreWatcher*>(events[i].data.ptr)->handleEvents();
+    }
+
+    // Send bundles whose windows have closed, and audits that are due.
+    for (auto& cab : cabinets) {
+      cab.watcher->flush();
+      cab.machine->auditCollector->tick();
+    }
+  }
+
+  close(ep);
+}
+
+static void printStats(const vector<Cabinet>& cabinets, long baseKb, double elapsed)
+{
+  ScoreWriter::Stats total;
+  for (const auto& cab : cabinets) {
+    const ScoreWriter::Stats& s = cab.writer->getStats();
+    total.games += s.games;
+    total.highScores += s.highScores;
+    total.writes += s.writes;
+    total.bytes += s.bytes;
+  }
+
+  const double n = static_cast<double>(cabinets.size());
+  const double cpu = cpuSeconds();
+  const long kb = residentKb();
+
+  cout << "cabinets=" << cabinets.size()
+       << " games=" << total.games
+       << " high_scores=" << total.highScores
+       << " writes=" << total.writes
+       << " cpu=" << cpu << "s"
+       << " rss=" << kb / 1024 << "MB"
+       << " per_cabinet: cpu=" << (elapsed > 0 ? cpu / elapsed / n * 100 : 0) << "%"
+       << " rss=" << static_cast<double>(kb - baseKb) / n << "KB" << endl;
+}
+
+int main(int argc, char** argv)
+{
+  string game_name, root, url = "ws://127.0.0.1:4444";
+  int count = 100, metrics_port = 0;
+  double perHour = 6, speed = 1, duration = 0, scanChance = 0.3, rampRate = 50;
+  unsigned seed = random_device()();
+
+  int opt;
+  while ((opt = getopt(argc, argv, "hR:c:g:w:p:s:d:q:r:m:n:")) != -1) {
+    switch (opt) {
+    case 'R':
+      root = optarg;
+      break;
+    case 'c':
+      count = atoi(optarg);
+      break;
+    case 'g':
+      game_name = optarg;
+      break;
+    case 'w':
+      url = optarg;
+      break;
+    case 'p':
+      perHour = atof(optarg);
+      break;
+    case 's':
+      speed = atof(optarg);
+      break;
+    case 'd':
+      duration = parseDuration(optarg);
+      break;
+    case 'q':
+      scanChance = atof(optarg);
+      break;
+    case 'r':
+      rampRate = atof(optarg);
+      break;
+    case 'm':
+      metrics_port = atoi(optarg);
+      break;
+    case 'n':
+      seed = static_cast<unsigned>(strtoul(optarg, nullptr, 10));
+      break;
+    default:
+      printUsage(argv[0]);
+    }
+  }
+
+  if (root.empty() || count <= 0 || perHour <= 0 || speed <= 0 || rampRate <= 0) {
+    printUsage(argv[0]);
+  }
+
+  vector<string> games;
+  if (!game_name.empty()) {
+    games.push_back(game_name);
+  }
+  else {
+    for (const auto& factory : gameFactories) games.push_back(factory.first);
+  }
+
+  if (!GameBase::create(games.front())) {
+    cerr << "Invalid game name: " << games.front() << endl;
+    return EXIT_FAILURE;
+  }
+
+  Log::start();
+  atexit(Log::stop);
+
+  signal(SIGINT, [](int) { running.store(false); });
+  signal(SIGTERM, [](int) { running.store(false); });
+  signal(SIGPIPE, SIG_IGN);
+
+  const long baseKb = residentKb();
+  vector<Cabinet> cabinets;
+  cabinets.reserve(static_cast<size_t>(count));
+
+  cout << "Starting " << count << " cabinets under " << root << " (seed " << seed << ")" << endl;
+
+  auto ramp = chrono::steady_clock::now();
+
+  for (int i = 0; i < count && running.load(); i++) {
+    Cabinet cab;
+    unique_ptr<GameBase> game = GameBase::create(games[static_cast<size_t>(i) % games.size()]);
+    game->relocate(root + "/cab" + to_string(i));
+
+    cab.machine = make_unique<Machine>(move(game));
+    Machine& m = *cab.machine;
+
+    try {
+      cab.writer = make_unique<ScoreWriter>(*m.game, seed + static_cast<unsigned>(i));
+      cab.writer->init();
+      m.config.load();
+
+      m.webSocket = make_shared<WebSocket>(vector<string>{url}, m);
+      m.webSocket->connect();
+      m.playerHandler = make_shared<Player>(m);
+      m.auditCollector = make_unique<AuditCollector>(m);
+      m.history = make_unique<ScoreHistory>(m.game->getGamePath() + "/.ssbd-history");
+      cab.watcher = make_unique<ScoreWatcher>(m);
+    }
+    catch (const runtime_error& e) {
+      cerr << "Cabinet " << i << ": " << e.what() << endl;
+      running.store(false);
+      break;
+    }
+
+    cabinets.push_back(move(cab));
+
+    ramp += chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(1 / rampRate));
+    this_thread::sleep_until(ramp);
+  }
+
+  if (!running.load()) {
+    cabinets.clear();
+    return EXIT_FAILURE;
+  }
+
+  Metrics::startExporter(root + "/ssbd-metrics.sock", metrics_port);
+  isRunning.store(true);
+
+  thread watcherThread(watchAll, ref(cabinets));
+
+  // Game ends across the fleet form one Poisson process; each lands on
+  // a cabinet chosen at random.
+  mt19937_64 rng(seed);
+  exponential_distribution<double> gap(perHour / 3600 * static_cast<double>(cabinets.size()));
+  uniform_int_distribution<size_t> pick(0, cabinets.size() - 1);
+
+  const auto start = chrono::steady_clock::now();
+  auto nextReport = start + chrono::seconds(10);
+  double t = 0;
+
+  while (running.load()) {
+    t += gap(rng);
+    if (duration > 0 && t > duration) break;
+
+    auto due = start + chrono::duration_cast<chrono::steady_clock::duration>(
+      chrono::duration<double>(t / speed));
+
+    while (running.load() && chrono::steady_clock::now() < due) {
+      this_thread::sleep_for(min<chrono::steady_clock::duration>(
+        due - chrono::steady_clock::now(), chrono::milliseconds(200)));
+    }
+
+    if (!running.load()) break;
+
+    Cabinet& cab = cabinets[pick(rng)];
+    fakeScan(*cab.machine, scanChance, rng);
+
+    try {
+      cab.writer->playGame();
+    }
+    catch (const runtime_error& e) {
+      cerr << e.what() << endl;
+      break;
+    }
+
+    if (chrono::steady_clock::now() >= nextReport) {
+      printStats(cabinets, baseKb, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+      nextReport += chrono::seconds(10);
+    }
+  }
+
+  running.store(false);
+  watcherThread.join();
+
+  printStats(cabinets, baseKb, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+
+  isRunning.store(false);
+  Metrics::stopExporter();
+  cabinets.clear();
+  return EXIT_SUCCESS;
+}
+
+// vim: set ts=2 sw=2 expandtab:
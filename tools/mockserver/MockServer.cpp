@@ -0,0 +1,548 @@
+// Spooky Scoreboard Daemon
+// Copyright (C) 2025 Greg MacKenzie
+// https://spookyscoreboard.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include <uuid/uuid.h>
+
+#include "Cbor.h"
+#include "WebSocket.h"
+#include "mockserver/MockServer.h"
+
+// Side of the generated QR code, in modules.
+#define MOCK_QR_SIZE 29
+
+using namespace std;
+
+MockServer::MockServer(const Options& opts) :
+  options(opts),
+  server(opts.port, opts.host),
+  rng(opts.seed)
+{
+  server.setOnClientMessageCallback([this](shared_ptr<ix::ConnectionState>,
+                                           ix::WebSocket& client,
+                                           const ix::WebSocketMessagePtr& msg) {
+    onMessage(client, msg);
+  });
+}
+
+MockServer::~MockServer()
+{
+  stop();
+}
+
+void MockServer::start()
+{
+  if (!options.recordPath.empty()) {
+    record.open(options.recordPath, ios::app);
+    if (!record) throw runtime_error("Failed to open " + options.recordPath);
+  }
+
+  auto res = server.listen();
+  if (!res.first) throw runtime_error("Failed to listen: " + res.second);
+
+  running.store(true);
+  server.start();
+
+  replyThread = thread(&MockServer::sendReplies, this);
+  if (options.disconnectSecs > 0) {
+    disconnectThread = thread(&MockServer::disconnectClients, this);
+  }
+}
+
+void MockServer::stop()
+{
+  if (!running.exchange(false)) return;
+
+  cv.notify_all();
+  if (replyThread.joinable()) replyThread.join();
+  if (disconnectThread.joinable()) disconnectThread.join();
+
+  server.stop();
+}
+
+void MockServer::onMessage(ix::WebSocket& client, const ix::WebSocketMessagePtr& msg)
+{
+  switch (msg->type) {
+  case ix::WebSocketMessageType::Open: {
+    auto it = msg->openInfo.headers.find("X-Machine-Uuid");
+    string machine = it != msg->openInfo.headers.end() ? it->second : "";
+
+    // The handshake can't carry extra headers back, so CBOR support is
+    // confirmed with a binary frame instead.
+    it = msg->openInfo.headers.find(WS_ENCODING_HEADER);
+    const bool cbor = it != msg->openInfo.headers.end() && it->second == WS_ENCODING_CBOR;
+
+    lock_guard<mutex> lock(mtx);
+    machines[&client] = machine;
+
+    if (cbor) {
+      Json::Value hello;
+      hello["encoding"] = WS_ENCODING_CBOR;
+      cborClients.insert(&client);
+      send(client, hello);
+    }
+    break;
+  }
+
+  case ix::WebSocketMessageType::Close: {
+    lock_guard<mutex> lock(mtx);
+    machines.erase(&client);
+    cborClients.erase(&client);
+    for (auto it = relayed.begin(); it != relayed.end(); ) {
+      if (it->second == &client) it = relayed.erase(it);
+      else ++it;
+    }
+    break;
+  }
+
+  case ix::WebSocketMessageType::Message: {
+    Json::Value req;
+    const bool ok = msg->binary ? Cbor::decode(msg->str, req) : Json::Reader().parse(msg->str, req);
+    if (ok && req.isObject()) handleRequest(client, req, msg->binary);
+    break;
+  }
+
+  default:
+    break;
+  }
+}
+
+void MockServer::handleRequest(ix::WebSocket& client, const Json::Value& req, bool binary)
+{
+  string body;
+  const int routed = route(req, body);
+  int status = routed;
+  const string path = req["path"].asString();
+
+  lock_guard<mutex> lock(mtx);
+
+  auto override = options.pathStatus.find(path);
+  if (override != options.pathStatus.end()) {
+    status = override->second;
+  }
+  else if (bernoulli_distribution(options.errorRate)(rng)) {
+    status = options.errorStatus;
+  }
+
+  // Injected failures get a generic body; real ones keep their reason.
+  if (status != routed) body = "{\"message\":\"Mock error\"}";
+
+  // Requests relayed by a gateway name the cabinet they came from.
+  string machine = machines[&client];
+  if (req.isMember("uuid")) {
+    machine = req["uuid"].asString();
+    relayed[machine] = &client;
+  }
+
+  Json::Value rec;
+  rec["recv_ms"] = nowMs();
+  rec["machine"] = machine;
+  rec["path"] = path;
+  rec["method"] = req["method"];
+  rec["query"] = req["query"];
+  rec["request_id"] = req["request_id"];
+  rec["version"] = req["version"];
+  rec["status"] = status;
+
+  PathStats& ps = stats[path];
+  ++ps.requests;
+  if (status != 200) ++ps.errors;
+
+  // Requests without an id expect no response.
+  if (!req.isMember("request_id")) {
+    if (record) record << Json::FastWriter().write(rec);
+    return;
+  }
+
+  if (bernoulli_distribution(options.loss)(rng)) {
+    ++ps.dropped;
+    rec["dropped"] = true;
+    if (record) record << Json::FastWriter().write(rec);
+    return;
+  }
+
+  Json::Value resp;
+  resp["request_id"] = req["request_id"];
+  resp["status"] = status;
+  resp["body"] = body;
+
+  int delay = options.latencyMs;
+  if (options.jitterMs > 0) delay += uniform_int_distribution<int>(0, options.jitterMs)(rng);
+
+  // Responses use the encoding of their request.
+  string payload;
+  if (binary) {
+    Cbor::encode(resp, payload);
+  }
+  else {
+    Json::StreamWriterBuilder writerBuilder;
+    writerBuilder["indentation"] = "";
+    payload = Json::writeString(writerBuilder, resp);
+  }
+
+  replies.push({
+    Clock::now() + chrono::milliseconds(delay),
+    &client,
+    payload,
+    binary,
+    rec
+  });
+
+  cv.notify_all();
+}
+
+/**
+ * Produces a response body the way the real backend would.
+ * Bodies are JSON strings; the QR code is XPM text.
+ */
+int MockServer::route(const Json::Value& req, string& body)
+{
+  const string path = req["path"].asString();
+  Json::Value msg;
+
+  if (path == "/api/v1/score") {
+    const string type = queryParam(req["query"].asString(), "type");
+    string error;
+
+    if (type == "bundle") checkBundle(req["body"], error);
+    else if (type != "classic" && type != "last" && type != "mode") error = "Unknown score type.";
+
+    if (!error.empty()) {
+      cerr << "Rejected score upload: " << error << endl;
+      msg["message"] = error;
+      body = Json::FastWriter().write(msg);
+      return 400;
+    }
+
+    msg["message"] = "Scores saved.";
+  }
+  else if (path == "/api/v1/audits") {
+    msg["message"] = "Audits saved.";
+  }
+  else if (path == "/api/v1/leaderboard") {
+    lock_guard<mutex> lock(mtx);
+    msg["message"] = leaderboardSnapshot();
+  }
+  else if (path == "/api/v1/ping") {
+    msg["message"] = "pong";
+  }
+  else if (path == "/api/v1/login") {
+    const string uuid = req["body"][0].asString();
+    msg["message"]["username"] = "Player-" + uuid.substr(0, 4);
+  }
+  else if (path == "/api/v1/register") {
+    msg["message"]["uuid"] = randomUuid();
+    msg["message"]["token"] = randomUuid();
+  }
+  else if (path == "/api/v1/qr") {
+    body = qrCodeXpm();
+    return 200;
+  }
+  else {
+    body = "{\"message\":\"Not found\"}";
+    return 404;
+  }
+
+  body = Json::FastWriter().write(msg);
+  return 200;
+}
+
+/**
+ * Sends responses once their simulated latency has passed.
+ */
+void MockServer::sendReplies()
+{
+  unique_lock<mutex> lock(mtx);
+
+  while (running.load()) {
+    if (replies.empty()) {
+      cv.wait(lock);
+      continue;
+    }
+
+    if (cv.wait_until(lock, replies.top().due) != cv_status::timeout &&
+        Clock::now() < replies.top().due) {
+      continue;
+    }
+
+    Reply reply = replies.top();
+    replies.pop();
+
+    // The client may have gone while the reply waited.
+    if (machines.find(reply.client) == machines.end()) {
+      reply.record["dropped"] = true;
+    }
+    else {
+      reply.client->send(reply.payload, reply.binary);
+      reply.record["sent_ms"] = nowMs();
+    }
+
+    if (record) record << Json::FastWriter().write(reply.record);
+  }
+}
+
+void MockServer::disconnectClients()
+{
+  exponential_distribution<double> gap(1.0 / options.disconnectSecs);
+  unique_lock<mutex> lock(mtx);
+
+  while (running.load()) {
+    auto wait = chrono::duration<double>(gap(rng));
+    if (cv.wait_for(lock, wait, [this]() { return !running.load(); })) break;
+
+    lock.unlock();
+    for (const auto& client : server.getClients()) {
+      client->close(1011, "Mock disconnect");
+    }
+    lock.lock();
+  }
+}
+
+void MockServer::broadcast(Json::Value cmd)
+{
+  lock_guard<mutex> lock(mtx);
+
+  for (const auto& client : server.getClients()) {
+    auto it = machines.find(client.get());
+    if (it == machines.end() || it->second.empty()) continue;
+
+    cmd["uuid"] = it->second;
+    send(*client, cmd);
+  }
+
+  for (const auto& r : relayed) {
+    cmd["uuid"] = r.first;
+    send(*r.second, cmd);
+  }
+}
+
+/**
+ * Sends a message in the client's encoding. Requires mtx.
+ */
+void MockServer::send(ix::WebSocket& client, const Json::Value& msg)
+{
+  if (cborClients.count(&client)) {
+    string payload;
+    Cbor::encode(msg, payload);
+    client.sendBinary(payload);
+    return;
+  }
+
+  Json::StreamWriterBuilder writerBuilder;
+  writerBuilder["indentation"] = "";
+  client.sendText(Json::writeString(writerBuilder, msg));
+}
+
+/**
+ * The leaderboard as a snapshot. Requires mtx.
+ */
+Json::Value MockServer::leaderboardSnapshot()
+{
+  Json::Value snapshot;
+  snapshot["seq"] = static_cast<Json::UInt64>(leaderboardSeq);
+  snapshot["snapshot"] = Json::arrayValue;
+
+  for (const auto& entry : leaderboard) {
+    Json::Value e;
+    e["name"] = entry.first;
+    e["score"] = static_cast<Json::UInt64>(entry.second);
+    snapshot["snapshot"].append(e);
+  }
+
+  return snapshot;
+}
+
+void MockServer::pushLeaderboard(bool show)
+{
+  Json::Value cmd;
+  {
+    lock_guard<mutex> lock(mtx);
+    cmd = leaderboardSnapshot();
+  }
+
+  cmd["cmd"] = "leaderboard";
+  cmd["show"] = show;
+  broadcast(cmd);
+}
+
+void MockServer::setLeaderboardScore(const string& name, uint64_t score)
+{
+  Json::Value cmd;
+  cmd["cmd"] = "leaderboard";
+
+  Json::Value e;
+  e["name"] = name;
+  e["score"] = static_cast<Json::UInt64>(score);
+  cmd["upsert"].append(e);
+
+  {
+    lock_guard<mutex> lock(mtx);
+    leaderboard[name] = score;
+    cmd["base"] = static_cast<Json::UInt64>(leaderboardSeq++);
+    cmd["seq"] = static_cast<Json::UInt64>(leaderboardSeq);
+  }
+
+  broadcast(cmd);
+}
+
+string MockServer::summary()
+{
+  lock_guard<mutex> lock(mtx);
+  ostringstream out;
+
+  out << machines.size() << " machine(s) connected, "
+      << relayed.size() << " behind a gateway\n";
+  for (const auto& ps : stats) {
+    out << "  " << ps.first
+        << ": requests=" << ps.second.requests
+        << " errors=" << ps.second.errors
+        << " dropped=" << ps.second.dropped << "\n";
+  }
+
+  return out.str();
+}
+
+/**
+ * Checks a game-over bundle the way the backend does:
+ * {"last": [...], "high": ..., "audits": {"delta"|"full": {NAME: N}}},
+ * at least one of them and nothing else. Deltas only count up.
+ *
+ * @return False, with the reason in error, if it's malformed.
+ */
+bool MockServer::checkBundle(const Json::Value& bundle, string& error)
+{
+  if (!bundle.isObject() || bundle.empty()) {
+    error = "Bundle must be a non-empty object.";
+    return false;
+  }
+
+  for (const auto& key : bundle.getMemberNames()) {
+    if (key != "last" && key != "high" && key != "audits") {
+      error = "Unexpected bundle field: " + key;
+      return false;
+    }
+  }
+
+  if (bundle.isMember("last") && !bundle["last"].isArray()) {
+    error = "Bundle last scores must be an array.";
+    return false;
+  }
+
+  if (bundle.isMember("high") && !bundle["high"].isArray() && !bundle["high"].isObject()) {
+    error = "Bundle high scores must be an array or object.";
+    return false;
+  }
+
+  if (!bundle.isMember("audits")) return true;
+
+  const Json::Value& audits = bundle["audits"];
+  if (!audits.isObject() || audits.size() != 1 || (!audits.isMember("delta") && !audits.isMember("full"))) {
+    error = "Bundle audits must hold one of delta or full.";
+    return false;
+  }
+
+  const bool delta = audits.isMember("delta");
+  const Json::Value& counters = delta ? audits["delta"] : audits["full"];
+  if (!counters.isObject() || counters.empty()) {
+    error = "Bundle audits must not be empty.";
+    return false;
+  }
+
+  for (const auto& name : counters.getMemberNames()) {
+    const Json::Value& value = counters[name];
+    if (!value.isIntegral() || (delta ? value.asInt64() <= 0 : value.asInt64() < 0)) {
+      error = "Bad audit counter: " + name;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * Finds a parameter in a query string, e.g. type in "type=bundle".
+ */
+string MockServer::queryParam(const string& query, const string& name)
+{
+  istringstream in(query);
+  string pair;
+
+  while (getline(in, pair, '&')) {
+    const size_t eq = pair.find('=');
+    if (pair.compare(0, eq, name) == 0 && eq == name.size()) return pair.substr(eq + 1);
+  }
+
+  return "";
+}
+
+string MockServer::randomUuid()
+{
+  uuid_t uuid;
+  char id[37];
+  uuid_generate_random(uuid);
+  uuid_unparse_lower(uuid, id);
+  return id;
+}
+
+/**
+ * A QR-like image: three finder patterns and a fixed pseudo-random fill.
+ * It won't scan, but it exercises the daemon's XPM decoding.
+ */
+string MockServer::qrCodeXpm()
+{
+  auto finder = [](int x, int y) {
+    int d = max(abs(x - 3), abs(y - 3));
+    return x < 7 && y < 7 && d != 2;
+  };
+
+  string out = "/* XPM */\nstatic char *qr[] = {\n";
+  out += "\"" + to_string(MOCK_QR_SIZE) + " " + to_string(MOCK_QR_SIZE) + " 2 1\",\n";
+  out += "\"  c #FFFFFF\",\n";
+  out += "\". c #000000\",\n";
+
+  uint32_t lcg = 12345;
+  for (int y = 0; y < MOCK_QR_SIZE; y++) {
+    out += '"';
+    for (int x = 0; x < MOCK_QR_SIZE; x++) {
+      const int fx = MOCK_QR_SIZE - 1 - x, fy = MOCK_QR_SIZE - 1 - y;
+      bool dark;
+
+      if (x < 8 && y < 8) dark = finder(x, y);
+      else if (fx < 8 && y < 8) dark = finder(fx, y);
+      else if (x < 8 && fy < 8) dark = finder(x, fy);
+      else {
+        lcg = lcg * 1103515245 + 12345;
+        dark = (lcg >> 16) & 1;
+      }
+
+      out += dark ? '.' : ' ';
+    }
+    out += y + 1 < MOCK_QR_SIZE ? "\",\n" : "\"\n";
+  }
+
+  return out + "};\n";
+}
+
+double MockServer::nowMs()
+{
+  return chrono::duration<double, milli>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// vim: set ts=2 sw=2 expandtab:
@@ -0,0 +1,164 @@
+// Spooky Scoreboard Daemon
+// Copyright (C) 2025 Greg MacKenzie
+// https://spookyscoreboard.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <ixwebsocket/IXWebSocketServer.h>
+#include <json/json.h>
+
+/**
+ * A stand-in for the scoreboard backend, speaking the daemon's request/
+ * response protocol with configurable latency, loss and failures.
+ */
+class MockServer
+{
+public:
+  struct Options {
+    int port = 4444;
+    std::string host = "127.0.0.1";
+
+    // Response delay: base plus uniform jitter, in milliseconds.
+    int latencyMs = 0;
+    int jitterMs = 0;
+
+    // Chance a response is never sent.
+    double loss = 0.0;
+
+    // Chance a response carries errorStatus instead of 200.
+    double errorRate = 0.0;
+    int errorStatus = 500;
+
+    // Fixed status for particular paths, e.g. /api/v1/login => 403.
+    std::map<std::string, int> pathStatus;
+
+    // Mean seconds between forced disconnects of every client; 0 disables.
+    double disconnectSecs = 0.0;
+
+    // File to record every request to, as JSON lines.
+    std::string recordPath;
+
+    unsigned seed = 0;
+  };
+
+  explicit MockServer(const Options& opts);
+  ~MockServer();
+
+  /**
+   * @brief Starts listening. Throws runtime_error on failure.
+   */
+  void start();
+  void stop();
+
+  /**
+   * @brief Sends a server command to every connected machine.
+   *
+   * @param cmd Command fields; "uuid" is filled in per machine.
+   */
+  void broadcast(Json::Value cmd);
+
+  /**
+   * @brief Pushes the whole leaderboard to every machine.
+   *
+   * @param show Whether cabinets should display it.
+   */
+  void pushLeaderboard(bool show);
+
+  /**
+   * @brief Sets a leaderboard score and pushes the change as a delta.
+   */
+  void setLeaderboardScore(const std::string& name, uint64_t score);
+
+  /**
+   * @brief Summarizes requests handled so far, per path.
+   */
+  std::string summary();
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  // A response waiting out its simulated latency.
+  struct Reply {
+    Clock::time_point due;
+    ix::WebSocket* client;
+    std::string payload;
+    bool binary;
+    Json::Value record;
+
+    bool operator>(const Reply& other) const { return due > other.due; }
+  };
+
+  struct PathStats {
+    uint64_t requests = 0;
+    uint64_t dropped = 0;
+    uint64_t errors = 0;
+  };
+
+  Options options;
+  ix::WebSocketServer server;
+
+  std::atomic<bool> running{false};
+  std::thread replyThread, disconnectThread;
+  std::mutex mtx;
+  std::condition_variable cv;
+  std::priority_queue<Reply, std::vector<Reply>, std::greater<Reply>> replies;
+
+  // Machine UUIDs of connected clients, from the X-Machine-Uuid header.
+  std::map<ix::WebSocket*, std::string> machines;
+
+  // Clients that asked for CBOR frames.
+  std::set<ix::WebSocket*> cborClients;
+
+  // Cabinets behind a gateway, by the machine UUID their requests carry.
+  std::map<std::string, ix::WebSocket*> relayed;
+  std::map<std::string, PathStats> stats;
+
+  // Leaderboard scores by name, and the sequence number of the last change.
+  std::map<std::string, uint64_t> leaderboard;
+  uint64_t leaderboardSeq = 0;
+
+  std::mt19937_64 rng;
+  std::ofstream record;
+
+  void onMessage(ix::WebSocket& client, const ix::WebSocketMessagePtr& msg);
+  void handleRequest(ix::WebSocket& client, const Json::Value& req, bool binary);
+  int route(const Json::Value& req, std::string& body);
+  void sendReplies();
+  void send(ix::WebSocket& client, const Json::Value& msg);
+  void disconnectClients();
+  Json::Value leaderboardSnapshot();
+
+  static bool checkBundle(const Json::Value& bundle, std::string& error);
+  static std::string queryParam(const std::string& query, const std::string& name);
+  static std::string randomUuid();
+  static std::string qrCodeXpm();
+  static double nowMs();
+};
+
+// vim: set ts=2 sw=2 expandtab:
@@ -0,0 +1,226 @@
+// Spooky Scoreboard Daemon
+// Copyright (C) 2025 Greg MacKenzie
+// https://spookyscoreboard.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// ssbd-mockserver: a local stand-in for the scoreboard backend.
+//
+// Point the daemon at it with -w ws://127.0.0.1:PORT. Server commands
+// are typed on stdin:
+//   logout POSITION
+//   message [id=ID] [priority=N] [duration=SECS] [ttl=SECS] [delay=SECS] TEXT
+//   token_rotate
+//   leaderboard
+//   score NAME SCORE
+//   endpoints wss://URL...
+//   stats
+
+#include <atomic>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#include <unistd.h>
+#include <uuid/uuid.h>
+#include <ixwebsocket/IXNetSystem.h>
+
+#include "version.h"
+#include "mockserver/MockServer.h"
+
+using namespace std;
+
+static atomic<bool> running{true};
+
+static void printUsage(const char* argv0)
+{
+  cerr << "Spooky Scoreboard mock server (ssbd-mockserver) v" << Version::FULL << "\n";
+  cerr << "Usage: " << argv0 << " [OPTIONS]" << "\n\n";
+  cerr << "Options:" << endl;
+  cerr << "  -p PORT       Port to listen on (default 4444)\n\n";
+  cerr << "  -H HOST       Address to listen on (default 127.0.0.1)\n\n";
+  cerr << "  -l MS         Response latency (default 0)\n\n";
+  cerr << "  -j MS         Extra random latency, up to MS (default 0)\n\n";
+  cerr << "  -x PROB       Chance a response is lost (default 0)\n\n";
+  cerr << "  -e PROB       Chance a response is an error (default 0)\n\n";
+  cerr << "  -E CODE       Status of error responses (default 500)\n\n";
+  cerr << "  -c PATH=CODE  Always respond to PATH with CODE; repeatable\n\n";
+  cerr << "  -d SECS       Mean time between forced disconnects (default never)\n\n";
+  cerr << "  -o FILE       Record every request to FILE as JSON lines\n\n";
+  cerr << "  -n SEED       Random seed (default random)\n\n";
+  cerr << "  -h            Displays usage\n" << endl;
+  exit(EXIT_SUCCESS);
+}
+
+static string randomToken()
+{
+  uuid_t uuid;
+  char id[37];
+  uuid_generate_random(uuid);
+  uuid_unparse_lower(uuid, id);
+  return id;
+}
+
+/**
+ * Reads server commands from stdin until EOF.
+ */
+static void console(MockServer& server)
+{
+  string line;
+
+  while (running.load() && getline(cin, line)) {
+    istringstream in(line);
+    string cmd;
+    in >> cmd;
+
+    Json::Value msg;
+    msg["cmd"] = cmd;
+
+    if (cmd == "logout") {
+      int position = 0;
+      in >> position;
+      msg["position"] = position;
+      server.broadcast(msg);
+    }
+    else if (cmd == "message") {
+      string text;
+      getline(in >> ws, text);
+
+      // Leading key=value words set the message's options.
+      size_t eq, sp;
+      while ((eq = text.find('=')) != string::npos &&
+             ((sp = text.find(' ')) == string::npos || eq < sp)) {
+        string key = text.substr(0, eq);
+        string value = text.substr(eq + 1, sp == string::npos ? string::npos : sp - eq - 1);
+        if (key == "id") msg[key] = value;
+        else msg[key] = atoi(value.c_str());
+        text = sp == string::npos ? "" : text.substr(sp + 1);
+      }
+
+      msg["message"] = text;
+      server.broadcast(msg);
+    }
+    else if (cmd == "token_rotate") {
+      msg["token"] = randomToken();
+      server.broadcast(msg);
+    }
+    else if (cmd == "leaderboard") {
+      server.pushLeaderboard(true);
+    }
+    else if (cmd == "score") {
+      string name;
+      uint64_t score = 0;
+      in >> name >> score;
+      server.setLeaderboardScore(name, score);
+    }
+    else if (cmd == "endpoints") {
+      string url;
+      msg["endpoints"] = Json::arrayValue;
+      while (in >> url) msg["endpoints"].append(url);
+      server.broadcast(msg);
+    }
+    else if (cmd == "stats") {
+      cout << server.summary() << flush;
+    }
+    else if (!cmd.empty()) {
+      cerr << "Unknown command: " << cmd << endl;
+    }
+  }
+}
+
+int main(int argc, char** argv)
+{
+  MockServer::Options opts;
+  opts.seed = random_device()();
+
+  int opt;
+  while ((opt = getopt(argc, argv, "hp:H:l:j:x:e:E:c:d:o:n:")) != -1) {
+    switch (opt) {
+    case 'p':
+      opts.port = atoi(optarg);
+      break;
+    case 'H':
+      opts.host = optarg;
+      break;
+    case 'l':
+      opts.latencyMs = atoi(optarg);
+      break;
+    case 'j':
+      opts.jitterMs = atoi(optarg);
+      break;
+    case 'x':
+      opts.loss = atof(optarg);
+      break;
+    case 'e':
+      opts.errorRate = atof(optarg);
+      break;
+    case 'E':
+      opts.errorStatus = atoi(optarg);
+      break;
+    case 'c': {
+      const char* eq = strchr(optarg, '=');
+      if (!eq) printUsage(argv[0]);
+      opts.pathStatus[string(optarg, static_cast<size_t>(eq - optarg))] = atoi(eq + 1);
+      break;
+    }
+    case 'd':
+      opts.disconnectSecs = atof(optarg);
+      break;
+    case 'o':
+      opts.recordPath = optarg;
+      break;
+    case 'n':
+      opts.seed = static_cast<unsigned>(strtoul(optarg, nullptr, 10));
+      break;
+    default:
+      printUsage(argv[0]);
+    }
+  }
+
+  ix::initNetSystem();
+
+  MockServer server(opts);
+
+  try {
+    server.start();
+  }
+  catch (const runtime_error& e) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  // No SA_RESTART, so a signal also interrupts the console's read.
+  struct sigaction sa = {};
+  sa.sa_handler = [](int) { running.store(false); };
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGINT, &sa, nullptr);
+  sigaction(SIGTERM, &sa, nullptr);
+
+  cout << "Listening on ws://" << opts.host << ":" << opts.port << endl;
+
+  // Keep serving after stdin closes, e.g. when run in the background.
+  console(server);
+  while (running.load()) {
+    this_thread::sleep_for(chrono::milliseconds(200));
+  }
+
+  cout << server.summary();
+  server.stop();
+  ix::uninitNetSystem();
+  return EXIT_SUCCESS;
+}
+
+// vim: set ts=2 sw=2 expandtab:
@@ -0,0 +1,288 @@
+// Spooky Scoreboard Daemon
+// Copyright (C) 2025 Greg MacKenzie
+// https://spookyscoreboard.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <uuid/uuid.h>
+#include <json/json.h>
+
+#include "sim/ScoreWriter.h"
+
+using namespace std;
+
+namespace
+{
+  // Regulars; league nights see the same initials over and over.
+  const char* regulars[] = {
+    "GRG", "MJS", "BEN", "SPK", "JLK", "ASH", "TOM", "LIZ", "DAN", "KAT",
+    "ROB", "AMY", "JAY", "SUE", "PAT", "MAX", "ZED", "ACE", "BOO", "EVL"
+  };
+
+  bool endsWith(const string& s, const string& suffix)
+  {
+    return s.size() >= suffix.size() &&
+           s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+  }
+
+  void mkdirs(const string& path)
+  {
+    for (size_t pos = path.find('/', 1); ; pos = path.find('/', pos + 1)) {
+      mkdir(path.substr(0, pos).c_str(), 0755);
+      if (pos == string::npos) break;
+    }
+  }
+}
+
+ScoreWriter::ScoreWriter(GameBase& g, unsigned seed) : game(g), rng(seed)
+{
+  const string& file = game.getHighScoresFile();
+
+  if (endsWith(file, ".yaml")) format = Format::Yaml;
+  else if (endsWith(file, ".json")) format = Format::Json;
+  else format = Format::Config;
+
+  // Factory defaults, as on a freshly installed game.
+  const uint64_t defaults[] = {1000000000, 750000000, 500000000, 250000000, 100000000, 50000000};
+  for (int i = 0; i < 6; i++) {
+    highScores.push_back({regulars[i], defaults[i]});
+  }
+}
+
+void ScoreWriter::init()
+{
+  mkdirs(game.getScoresPath());
+  mkdirs(game.getTmpPath());
+
+  string configPath = game.getGamePath() + "/.ssbd.json";
+  if (access(configPath.c_str(), F_OK) != 0) {
+    uuid_t uuid;
+    char id[37];
+    uuid_generate_random(uuid);
+    uuid_unparse_lower(uuid, id);
+
+    Json::Value config;
+    config["uuid"] = id;
+    config["token"] = "sim";
+    ofstream(configPath) << config;
+  }
+
+  writeGameFiles(true);
+}
+
+void ScoreWriter::playGame()
+{
+  int players = uniform_int_distribution<int>(1, 4)(rng);
+  bool changed = false;
+
+  lastScores.fill(0);
+
+  for (int i = 0; i < players; i++) {
+    lastScores[i] = randomScore();
+
+    if (lastScores[i] > highScores.back().score) {
+      highScores.back() = {randomInitials(), lastScores[i]};
+      sort(highScores.begin(), highScores.end(), [](const Entry& a, const Entry& b) {
+        return a.score > b.score;
+      });
+      changed = true;
+    }
+  }
+
+  ++gamesPlayed;
+  ++stats.games;
+  if (changed) ++stats.highScores;
+
+  writeGameFiles(changed);
+}
+
+uint64_t ScoreWriter::randomScore()
+{
+  // Scores are roughly log-normal: most games are short, a few great.
+  // Some games store scores as 32-bit values, so stay below 2^32.
+  lognormal_distribution<double> dist(log(80000000.0), 0.9);
+  return static_cast<uint64_t>(min(dist(rng), 4000000000.0) / 10) * 10;
+}
+
+string ScoreWriter::randomInitials()
+{
+  const size_t n = sizeof(regulars) / sizeof(regulars[0]);
+  return regulars[uniform_int_distribution<size_t>(0, n - 1)(rng)];
+}
+
+/**
+ * Halloween, Ultraman and TCM: one file with a header line, six
+ * initials/score pairs, and the last game's scores on lines 15-18.
+ */
+string ScoreWriter::renderConfig() const
+{
+  string out = "HIGHSCORES\n";
+  for (const auto& e : highScores) {
+    out += e.initials + "\n" + to_string(e.score) + "\n";
+  }
+
+  out += "LASTGAME\n";
+  for (uint64_t score : lastScores) {
+    out += to_string(score) + "\n";
+  }
+
+  return out;
+}
+
+string ScoreWriter::renderHighScoresJson() const
+{
+  Json::Value root(Json::arrayValue);
+  for (const auto& e : highScores) {
+    Json::Value score;
+    score["theScore"] = static_cast<Json::UInt64>(e.score);
+    score["playerName"] = e.initials + "    ";
+    score["modeName"] = Json::nullValue;
+    score["playerIndex"] = 1;
+    score["scoreBeaten"] = false;
+    score["scorePlace"] = -1;
+    root.append(score);
+  }
+
+  return root.toStyledString();
+}
+
+string ScoreWriter::renderLastScoresJson() const
+{
+  Json::Value root(Json::arrayValue);
+  for (uint64_t score : lastScores) {
+    root.append(static_cast<Json::UInt64>(score));
+  }
+
+  return root.toStyledString();
+}
+
+string ScoreWriter::renderAuditsJson() const
+{
+  Json::Value root;
+  root["games_played"]["label"] = "Games Played";
+  root["games_played"]["value"] = gamesPlayed;
+  root["games_started"]["label"] = "Games Started";
+  root["games_started"]["value"] = gamesPlayed;
+
+  return root.toStyledString();
+}
+
+/**
+ * TNA and ACNC keep scores and audits in a single YAML file.
+ */
+string ScoreWriter::renderYaml() const
+{
+  string out = "ClassicHighScores:\n";
+  for (const auto& e : highScores) {
+    out += "  - inits: " + e.initials + "\n";
+    out += "    score: " + to_string(e.score) + "\n";
+  }
+
+  out += "LastScoreData:\n";
+  for (int i = 0; i < 4; i++) {
+    out += "  Player" + to_string(i + 1) + "LastScore: " + to_string(lastScores[i]) + "\n";
+  }
+
+  out += "Audits:\n";
+  out += "  Games Played: " + to_string(gamesPlayed) + "\n";
+
+  return out;
+}
+
+void ScoreWriter::writeGameFiles(bool highScoresChanged)
+{
+  int repeats = 1;
+  if (bernoulli_distribution(burst)(rng)) {
+    repeats += uniform_int_distribution<int>(1, 4)(rng);
+  }
+
+  for (int i = 0; i < repeats; i++) {
+    switch (format) {
+    case Format::Config:
+      writeFile(game.getHighScoresFile(), renderConfig());
+      writeFile(game.getAuditsFile(), renderAuditsJson());
+      break;
+
+    case Format::Json:
+      if (highScoresChanged) writeFile(game.getHighScoresFile(), renderHighScoresJson());
+      writeFile(game.getLastScoresFile(), renderLastScoresJson());
+      writeFile(game.getAuditsFile(), renderAuditsJson());
+      break;
+
+    case Format::Yaml:
+      writeFile(game.getHighScoresFile(), renderYaml());
+      break;
+    }
+  }
+}
+
+void ScoreWriter::writeFile(const string& file, const string& content)
+{
+  string path = game.getScoresPath() + "/" + file;
+
+  Mode m = mode;
+  if (m == Mode::Mixed) {
+    m = static_cast<Mode>(uniform_int_distribution<int>(0, 2)(rng));
+  }
+
+  switch (m) {
+  case Mode::Rename: {
+    string tmp = game.getScoresPath() + "/." + file + ".tmp";
+    writeDirect(tmp, content, content.size());
+    if (rename(tmp.c_str(), path.c_str()) != 0) {
+      throw runtime_error("Failed to rename " + tmp);
+    }
+    break;
+  }
+
+  case Mode::Partial:
+    writeDirect(path, content, content.size() / 2);
+    writeDirect(path, content, content.size());
+    break;
+
+  default:
+    writeDirect(path, content, content.size());
+    break;
+  }
+}
+
+void ScoreWriter::writeDirect(const string& path, const string& content, size_t len)
+{
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) throw runtime_error("Failed to open " + path);
+
+  size_t off = 0;
+  while (off < len) {
+    ssize_t n = write(fd, content.data() + off, len - off);
+    if (n <= 0) {
+      close(fd);
+      throw runtime_error("Failed to write " + path);
+    }
+    off += static_cast<size_t>(n);
+  }
+
+  close(fd);
+  ++stats.writes;
+  stats.bytes += len;
+}
+
+// vim: set ts=2 sw=2 expandtab:
@@ -0,0 +1,112 @@
+// Spooky Scoreboard Daemon
+// Copyright (C) 2025 Greg MacKenzie
+// https://spookyscoreboard.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <array>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "GameBase.h"
+
+/**
+ * Plays simulated games of a GameBase and writes the score, last-score
+ * and audit files the game itself would, in the game's own format.
+ */
+class ScoreWriter
+{
+public:
+  // How files are replaced on disk.
+  enum class Mode {
+    Direct,   // Truncate and write in place.
+    Rename,   // Write a temporary file, then rename() it over the target.
+    Partial,  // Write and close half the file, then the whole file.
+    Mixed     // Any of the above, chosen per write.
+  };
+
+  struct Stats {
+    uint64_t games = 0;
+    uint64_t highScores = 0;
+    uint64_t writes = 0;
+    uint64_t bytes = 0;
+  };
+
+  /**
+   * @param g A game, already relocated to the simulated file system root.
+   * @param seed Seed for reproducible runs.
+   */
+  ScoreWriter(GameBase& g, unsigned seed);
+
+  /**
+   * @brief Creates the game's directories and initial files.
+   *
+   * Also writes a machine config (.ssbd.json) if there is none, so the
+   * daemon can run against the tree.
+   */
+  void init();
+
+  /**
+   * @brief Plays one game and writes the files it changes.
+   */
+  void playGame();
+
+  void setMode(Mode m) { mode = m; }
+
+  /**
+   * @brief Sets the chance a game end rewrites its files several times
+   *        in quick succession, as some games do.
+   */
+  void setBurst(double probability) { burst = probability; }
+
+  const Stats& getStats() const { return stats; }
+
+private:
+  enum class Format { Config, Json, Yaml };
+
+  struct Entry {
+    std::string initials;
+    uint64_t score;
+  };
+
+  GameBase& game;
+  Format format;
+  Mode mode = Mode::Direct;
+  double burst = 0.0;
+  Stats stats;
+  std::mt19937_64 rng;
+
+  std::vector<Entry> highScores;
+  std::array<uint64_t, 4> lastScores{};
+  uint32_t gamesPlayed = 0;
+
+  uint64_t randomScore();
+  std::string randomInitials();
+
+  std::string renderConfig() const;
+  std::string renderHighScoresJson() const;
+  std::string renderLastScoresJson() const;
+  std::string renderAuditsJson() const;
+  std::string renderYaml() const;
+
+  void writeGameFiles(bool highScoresChanged);
+  void writeFile(const std::string& file, const std::string& content);
+  void writeDirect(const std::string& path, const std::string& content, size_t len);
+};
+
+// vim: set ts=2 sw=2 expandtab:
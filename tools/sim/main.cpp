@@ -0,0 +1,253 @@
+// Spooky Scoreboard Daemon
+// Copyright (C) 2025 Greg MacKenzie
+// https://spookyscoreboard.com
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// ssbd-sim: simulates a cabinet's file system for load and soak testing.
+//
+// Plays games on a simulated clock and writes the files the real game
+// would, under ROOT. Run the daemon against the same tree with -R ROOT.
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <thread>
+
+#include <unistd.h>
+
+#include "GameBase.h"
+#include "version.h"
+#include "sim/ScoreWriter.h"
+
+using namespace std;
+
+static atomic<bool> running{true};
+
+// Relative play through a typical day, by hour; busiest in the evening.
+static const double hourWeights[24] = {
+  0.6, 0.3, 0.1, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.1, 0.3,
+  0.5, 0.5, 0.5, 0.6, 0.8, 1.0, 1.4, 1.8, 2.0, 2.0, 1.6, 1.0
+};
+
+// League nights: Tuesdays 19:00-23:00 see back-to-back games.
+#define SIM_LEAGUE_DAY 2
+#define SIM_LEAGUE_START 19
+#define SIM_LEAGUE_END 23
+#define SIM_LEAGUE_FACTOR 4.0
+
+static void printUsage(const char* argv0)
+{
+  cerr << "Spooky Scoreboard simulator (ssbd-sim) v" << Version::FULL << "\n";
+  cerr << "Usage: " << argv0 << " -g GAME -R ROOT [OPTIONS]" << "\n\n";
+  cerr << "Options:" << endl;
+  cerr << "  -g GAME   Game to simulate (see ssbd -l)\n\n";
+  cerr << "  -R ROOT   Directory to build the game's file system under\n\n";
+  cerr << "  -p RATE   Average games per hour (default 6)\n\n";
+  cerr << "  -s SPEED  Time compression; 720 plays a month in an hour (default 1)\n\n";
+  cerr << "  -d TIME   Simulated time to run, e.g. 90m, 12h, 30d (default forever)\n\n";
+  cerr << "  -w MODE   How files are written: direct, rename, partial or mixed\n";
+  cerr << "            (default direct)\n\n";
+  cerr << "  -b PROB   Chance a game end rewrites its files in a burst (default 0)\n\n";
+  cerr << "  -L        Simulate league nights\n\n";
+  cerr << "  -n SEED   Random seed (default random)\n\n";
+  cerr << "  -h        Displays usage\n" << endl;
+  exit(EXIT_SUCCESS);
+}
+
+/**
+ * Parses a duration like "45s", "90m", "12h" or "30d" into seconds.
+ */
+static double parseDuration(const char* arg)
+{
+  char* end;
+  double v = strtod(arg, &end);
+
+  switch (*end) {
+  case 'd': return v * 86400;
+  case 'h': return v * 3600;
+  case 'm': return v * 60;
+  default: return v;
+  }
+}
+
+/**
+ * Games per simulated second at time t.
+ */
+static double rateAt(double t, double perHour, bool league)
+{
+  static double mean = [] {
+    double sum = 0;
+    for (double w : hourWeights) sum += w;
+    return sum / 24;
+  }();
+
+  int hour = static_cast<int>(fmod(t / 3600, 24));
+  int day = static_cast<int>(t / 86400) % 7;
+
+  double rate = perHour / 3600 * hourWeights[hour] / mean;
+
+  if (league && day == SIM_LEAGUE_DAY && hour >= SIM_LEAGUE_START && hour < SIM_LEAGUE_END) {
+    rate *= SIM_LEAGUE_FACTOR;
+  }
+
+  return rate;
+}
+
+/**
+ * Sleeps until a point in time, waking early if interrupted.
+ */
+static void sleepUntil(chrono::steady_clock::time_point when)
+{
+  while (running.load() && chrono::steady_clock::now() < when) {
+    this_thread::sleep_for(min<chrono::steady_clock::duration>(
+      when - chrono::steady_clock::now(), chrono::milliseconds(200)));
+  }
+}
+
+static void printStats(int day, const ScoreWriter::Stats& s)
+{
+  cout << "day " << day + 1
+       << ": games=" << s.games
+       << " high_scores=" << s.highScores
+       << " writes=" << s.writes
+       << " bytes=" << s.bytes << endl;
+}
+
+int main(int argc, char** argv)
+{
+  string game_name, root;
+  double perHour = 6, speed = 1, duration = 0, burst = 0;
+  bool league = false;
+  unsigned seed = random_device()();
+  ScoreWriter::Mode mode = ScoreWriter::Mode::Direct;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "hg:R:p:s:d:w:b:Ln:")) != -1) {
+    switch (opt) {
+    case 'g':
+      game_name = optarg;
+      break;
+    case 'R':
+      root = optarg;
+      break;
+    case 'p':
+      perHour = atof(optarg);
+      break;
+    case 's':
+      speed = atof(optarg);
+      break;
+    case 'd':
+      duration = parseDuration(optarg);
+      break;
+    case 'w':
+      if (strcmp(optarg, "direct") == 0) mode = ScoreWriter::Mode::Direct;
+      else if (strcmp(optarg, "rename") == 0) mode = ScoreWriter::Mode::Rename;
+      else if (strcmp(optarg, "partial") == 0) mode = ScoreWriter::Mode::Partial;
+      else if (strcmp(optarg, "mixed") == 0) mode = ScoreWriter::Mode::Mixed;
+      else printUsage(argv[0]);
+      break;
+    case 'b':
+      burst = atof(optarg);
+      break;
+    case 'L':
+      league = true;
+      break;
+    case 'n':
+      seed = static_cast<unsigned>(strtoul(optarg, nullptr, 10));
+      break;
+    default:
+      printUsage(argv[0]);
+    }
+  }
+
+  if (game_name.empty() || root.empty() || perHour <= 0 || speed <= 0) {
+    printUsage(argv[0]);
+  }
+
+  unique_ptr<GameBase> game = GameBase::create(game_name);
+  if (!game) {
+    cerr << "Invalid game name: " << game_name << endl;
+    return EXIT_FAILURE;
+  }
+
+  signal(SIGINT, [](int) { running.store(false); });
+  signal(SIGTERM, [](int) { running.store(false); });
+
+  game->relocate(root);
+
+  ScoreWriter writer(*game, seed);
+  writer.setMode(mode);
+  writer.setBurst(burst);
+
+  try {
+    writer.init();
+  }
+  catch (const runtime_error& e) {
+    cerr << e.what() << endl;
+    return EXIT_FAILURE;
+  }
+
+  cout << "Simulating " << game->getGameName() << " in " << game->getScoresPath()
+       << " (seed " << seed << ")" << endl;
+
+  // Game ends are a Poisson process whose rate varies through the day,
+  // sampled by thinning against the highest possible rate.
+  double maxRate = 0;
+  for (int h = 0; h < 24 * 7; h++) {
+    maxRate = max(maxRate, rateAt(h * 3600.0, perHour, league));
+  }
+
+  mt19937_64 rng(seed + 1);
+  exponential_distribution<double> gap(maxRate);
+  uniform_real_distribution<double> accept(0, maxRate);
+
+  auto start = chrono::steady_clock::now();
+  double t = 0;
+  int lastDay = 0;
+
+  while (running.load()) {
+    t += gap(rng);
+    if (duration > 0 && t > duration) break;
+    if (accept(rng) > rateAt(t, perHour, league)) continue;
+
+    sleepUntil(start + chrono::duration_cast<chrono::steady_clock::duration>(
+      chrono::duration<double>(t / speed)));
+
+    if (!running.load()) break;
+
+    try {
+      writer.playGame();
+    }
+    catch (const runtime_error& e) {
+      cerr << e.what() << endl;
+      return EXIT_FAILURE;
+    }
+
+    int day = static_cast<int>(t / 86400);
+    if (day != lastDay) {
+      printStats(lastDay, writer.getStats());
+      lastDay = day;
+    }
+  }
+
+  printStats(lastDay, writer.getStats());
+  return EXIT_SUCCESS;
+}
+
+// vim: set ts=2 sw=2 expandtab: